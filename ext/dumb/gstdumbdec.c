@@ -11,6 +11,10 @@
 
 #include "dumb/include/internal/it.h"
 
+#if defined(_USE_SSE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 GST_DEBUG_CATEGORY_STATIC(dumbdec_debug);
 #define GST_CAT_DEFAULT dumbdec_debug
@@ -24,6 +28,15 @@ enum
 };
 
 
+enum
+{
+	SIGNAL_RENDER_CHUNK,
+	LAST_SIGNAL
+};
+
+static guint gst_dumb_dec_signals[LAST_SIGNAL] = { 0 };
+
+
 
 /* ramp styles (taken from foo_dumb mod.cpp) */
 #define DUMB_RAMP_STYLE_NONE 0
@@ -40,8 +53,10 @@ enum
 #define DEFAULT_SAMPLE_RATE 48000
 #define DEFAULT_NUM_CHANNELS 2
 
-#define RENDER_BIT_DEPTH 16
-#define AUDIO_FORMAT GST_AUDIO_FORMAT_S16
+#define DEFAULT_SAMPLE_FORMAT GST_AUDIO_FORMAT_F32
+
+/* DUMB mixes into 24-bit integer samples */
+#define DUMB_SAMPLE_SCALE 8388608.0f
 
 
 
@@ -59,19 +74,29 @@ static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
 	GST_STATIC_CAPS("audio/x-mod " MOD_CAPS_TYPESTR)
 );
 
+#define SRC_CAPS \
+	"audio/x-raw, " \
+	"format = (string) { " GST_AUDIO_NE(S16) ", " GST_AUDIO_NE(S32) ", " GST_AUDIO_NE(F32) " }, " \
+	"layout = (string) interleaved, " \
+	"rate = (int) [ 1, 48000 ], " \
+	"channels = (int) { 1, 2 } "
+
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
 	"src",
 	GST_PAD_SRC,
 	GST_PAD_ALWAYS,
-	GST_STATIC_CAPS(
-		"audio/x-raw, "
-		"format = (string) " GST_AUDIO_NE(S16) ", "
-		"layout = (string) interleaved, "
-		"rate = (int) [ 1, 48000 ], "
-		"channels = (int) { 1, 2 } "
-	)
+	GST_STATIC_CAPS(SRC_CAPS)
 );
 
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static GstStaticPadTemplate voice_template = GST_STATIC_PAD_TEMPLATE(
+	"voice_%u",
+	GST_PAD_SRC,
+	GST_PAD_REQUEST,
+	GST_STATIC_CAPS(SRC_CAPS)
+);
+#endif
+
 
 
 G_DEFINE_TYPE(GstDumbDec, gst_dumb_dec, GST_TYPE_NONSTREAM_AUDIO_DECODER)
@@ -91,6 +116,11 @@ static void gst_dumb_dec_get_property(GObject *object, guint prop_id, GValue *va
 
 static gboolean gst_dumb_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position);
 static GstClockTime gst_dumb_dec_tell(GstNonstreamAudioDecoder *dec);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static gboolean gst_dumb_dec_find_seek_points(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime *point_before, GstClockTime *point_after);
+#endif
+static long gst_dumb_dec_find_checkpoints(GstDumbDec *dumb_dec, long pos, long *checkpoint_after);
+static gboolean gst_dumb_dec_skip_to_pos(GstDumbDec *dumb_dec, long seek_pos);
 
 static guint gst_dumb_dec_check_initial_subsong_index(GstDumbDec *dumb_dec, guint initial_subsong);
 static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *source_data, guint initial_subsong, GstNonstreamAudioSubsongMode initial_subsong_mode, GstClockTime *initial_position, GstNonstreamAudioOutputMode *initial_output_mode, gint *initial_num_loops);
@@ -109,10 +139,23 @@ static guint gst_dumb_dec_get_supported_output_modes(GstNonstreamAudioDecoder *d
 static gboolean gst_dumb_dec_set_output_mode(GstNonstreamAudioDecoder *dec, GstNonstreamAudioOutputMode mode, GstClockTime *current_position);
 
 static gboolean gst_dumb_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer **buffer, guint *num_samples);
+static long gst_dumb_dec_render(GstDumbDec *dumb_dec, DUH_SIGRENDERER *sigrenderer, long num_samples, gpointer dest);
+static void gst_dumb_dec_convert_to_f32(gfloat *dest, sample_t const *src, long num_values);
+static void gst_dumb_dec_convert_to_s32(gint32 *dest, sample_t const *src, long num_values);
+static void gst_dumb_dec_convert_to_s16(gint16 *dest, sample_t const *src, long num_values);
+
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static guint gst_dumb_dec_get_num_voices(GstNonstreamAudioDecoder *dec);
+static gboolean gst_dumb_dec_decode_voices(GstNonstreamAudioDecoder *dec, guint const *voices, GstBuffer **buffers, guint num_voices, guint num_samples);
+static DUH_SIGRENDERER* gst_dumb_dec_start_voice_sigrenderer(GstDumbDec *dumb_dec, guint voice);
+#endif
+static void gst_dumb_dec_end_voice_sigrenderers(GstDumbDec *dumb_dec);
 
 static gboolean gst_dumb_dec_init_sigrenderer_at_pos(GstDumbDec *dumb_dec, long seek_pos);
 static gboolean gst_dumb_dec_init_sigrenderer_at_order(GstDumbDec *dumb_dec, int order);
 static void gst_dumb_dec_init_sigrenderer_common(GstDumbDec *dumb_dec);
+static void gst_dumb_dec_apply_render_settings(GstDumbDec *dumb_dec, DUH_SIGRENDERER *sigrenderer);
+static void gst_dumb_dec_update_render_settings(GstDumbDec *dumb_dec);
 
 static void gst_dumb_scan_for_subsongs(GstDumbDec *dumb_dec);
 
@@ -136,12 +179,19 @@ void gst_dumb_dec_class_init(GstDumbDecClass *klass)
 
 	dec_class->seek = GST_DEBUG_FUNCPTR(gst_dumb_dec_seek);
 	dec_class->tell = GST_DEBUG_FUNCPTR(gst_dumb_dec_tell);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	dec_class->find_seek_points = GST_DEBUG_FUNCPTR(gst_dumb_dec_find_seek_points);
+#endif
 	dec_class->load_from_buffer = GST_DEBUG_FUNCPTR(gst_dumb_dec_load_from_buffer);
 	dec_class->set_num_loops = GST_DEBUG_FUNCPTR(gst_dumb_dec_set_num_loops);
 	dec_class->get_num_loops = GST_DEBUG_FUNCPTR(gst_dumb_dec_get_num_loops);
 	dec_class->get_supported_output_modes = GST_DEBUG_FUNCPTR(gst_dumb_dec_get_supported_output_modes);
 	dec_class->set_output_mode = GST_DEBUG_FUNCPTR(gst_dumb_dec_set_output_mode);
 	dec_class->decode = GST_DEBUG_FUNCPTR(gst_dumb_dec_decode);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	dec_class->get_num_voices = GST_DEBUG_FUNCPTR(gst_dumb_dec_get_num_voices);
+	dec_class->decode_voices = GST_DEBUG_FUNCPTR(gst_dumb_dec_decode_voices);
+#endif
 	dec_class->set_current_subsong = GST_DEBUG_FUNCPTR(gst_dumb_dec_set_current_subsong);
 	dec_class->get_current_subsong = GST_DEBUG_FUNCPTR(gst_dumb_dec_get_current_subsong);
 	dec_class->get_num_subsongs = GST_DEBUG_FUNCPTR(gst_dumb_dec_get_num_subsongs);
@@ -150,6 +200,9 @@ void gst_dumb_dec_class_init(GstDumbDecClass *klass)
 
 	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_template));
 	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_template));
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&voice_template));
+#endif
 
 	gst_element_class_set_static_metadata(
 		element_class,
@@ -183,6 +236,32 @@ void gst_dumb_dec_class_init(GstDumbDecClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+
+	/**
+	 * GstDumbDec::render-chunk:
+	 * @dumbdec: the dumbdec instance
+	 * @position: current playback position, in nanoseconds
+	 *
+	 * Emitted from the streaming thread before each chunk of audio is
+	 * rendered. Changes to the resampling-quality and ramp-style properties
+	 * made from within the handler apply to that chunk already, which makes
+	 * this signal suitable for adapting the rendering quality on the fly
+	 * (for example, based on QoS information).
+	 *
+	 * The decoder lock is not held during emission, so the handler can
+	 * access any property of the element.
+	 */
+	gst_dumb_dec_signals[SIGNAL_RENDER_CHUNK] = g_signal_new(
+		"render-chunk",
+		G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST,
+		0,
+		NULL, NULL,
+		g_cclosure_marshal_generic,
+		G_TYPE_NONE,
+		1,
+		G_TYPE_UINT64
+	);
 }
 
 
@@ -197,6 +276,7 @@ void gst_dumb_dec_init(GstDumbDec *dumb_dec)
 
 	dumb_dec->resampling_quality = DEFAULT_RESAMPLING_QUALITY;
 	dumb_dec->ramp_style = DEFAULT_RAMP_STYLE;
+	dumb_dec->render_settings_changed = 0;
 
 	dumb_dec->subsongs = NULL;
 	dumb_dec->cur_subsong = 0;
@@ -204,6 +284,14 @@ void gst_dumb_dec_init(GstDumbDec *dumb_dec)
 	dumb_dec->num_subsongs = 0;
 	dumb_dec->subsongs_explicit = FALSE;
 	dumb_dec->cur_subsong_start_pos = 0;
+
+	dumb_dec->sample_format = DEFAULT_SAMPLE_FORMAT;
+	dumb_dec->sample_buffer = NULL;
+	dumb_dec->sample_buffer_size = 0;
+
+	dumb_dec->voice_sigrenderers = g_ptr_array_new();
+	dumb_dec->voice_sigrenderers_stale = FALSE;
+	dumb_dec->render_start_pos = 0;
 }
 
 
@@ -271,6 +359,12 @@ static void gst_dumb_dec_finalize(GObject *object)
 	if (dumb_dec->duh_sigrenderer != NULL)
 		duh_end_sigrenderer(dumb_dec->duh_sigrenderer);
 
+	gst_dumb_dec_end_voice_sigrenderers(dumb_dec);
+	g_ptr_array_free(dumb_dec->voice_sigrenderers, TRUE);
+
+	if (dumb_dec->sample_buffer != NULL)
+		destroy_sample_buffer(dumb_dec->sample_buffer);
+
 	if (dumb_dec->duh != NULL)
 		unload_duh(dumb_dec->duh);
 
@@ -280,44 +374,23 @@ static void gst_dumb_dec_finalize(GObject *object)
 
 static void gst_dumb_dec_set_property(GObject *object, guint prop_id, const GValue *value, G_GNUC_UNUSED GParamSpec *pspec)
 {
-	GstNonstreamAudioDecoder *dec;
-	GstDumbDec *dumb_dec;
-
-	dec = GST_NONSTREAM_AUDIO_DECODER(object);
-	dumb_dec = GST_DUMB_DEC(object);
+	GstDumbDec *dumb_dec = GST_DUMB_DEC(object);
 
 	switch (prop_id)
 	{
+		/* The render settings are only staged here; the streaming thread
+		 * picks them up at the start of the next chunk. This way, they can
+		 * be changed without waiting for the decoder lock. */
 		case PROP_RESAMPLING_QUALITY:
-		{
-			DUMB_IT_SIGRENDERER *itsr;
-
-			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
-			dumb_dec->resampling_quality = g_value_get_enum(value);
-			if (dumb_dec->duh_sigrenderer != NULL)
-			{
-				itsr = duh_get_it_sigrenderer(dumb_dec->duh_sigrenderer);
-				dumb_it_set_resampling_quality(itsr, dumb_dec->resampling_quality);
-			}
-			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
-
+			g_atomic_int_set(&(dumb_dec->resampling_quality), g_value_get_enum(value));
+			g_atomic_int_set(&(dumb_dec->render_settings_changed), 1);
 			break;
-		}
-		case PROP_RAMP_STYLE:
-		{
-			DUMB_IT_SIGRENDERER *itsr;
-
-			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
-			dumb_dec->ramp_style = g_value_get_enum(value);
-			if (dumb_dec->duh_sigrenderer != NULL)
-			{
-				itsr = duh_get_it_sigrenderer(dumb_dec->duh_sigrenderer);
-				dumb_it_set_ramp_style(itsr, dumb_dec->ramp_style);
-			}
-			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 
+		case PROP_RAMP_STYLE:
+			g_atomic_int_set(&(dumb_dec->ramp_style), g_value_get_enum(value));
+			g_atomic_int_set(&(dumb_dec->render_settings_changed), 1);
 			break;
-		}
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -332,15 +405,11 @@ static void gst_dumb_dec_get_property(GObject *object, guint prop_id, GValue *va
 	switch (prop_id)
 	{
 		case PROP_RESAMPLING_QUALITY:
-			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
-			g_value_set_enum(value, dumb_dec->resampling_quality);
-			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			g_value_set_enum(value, g_atomic_int_get(&(dumb_dec->resampling_quality)));
 			break;
 
 		case PROP_RAMP_STYLE:
-			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
-			g_value_set_enum(value, dumb_dec->ramp_style);
-			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			g_value_set_enum(value, g_atomic_int_get(&(dumb_dec->ramp_style)));
 			break;
 
 		default:
@@ -364,6 +433,13 @@ static gboolean gst_dumb_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *n
 	dumb_dec->cur_loop_count = 0;
 	pos = gst_util_uint64_scale_int(*new_position, 65536, GST_SECOND) + dumb_dec->cur_subsong_start_pos;
 
+	if (gst_dumb_dec_skip_to_pos(dumb_dec, pos))
+	{
+		*new_position = gst_dumb_dec_tell(dec);
+		GST_DEBUG_OBJECT(dec, "position after skipping ahead: %" GST_TIME_FORMAT, GST_TIME_ARGS(*new_position));
+		return TRUE;
+	}
+
 	if (!gst_dumb_dec_init_sigrenderer_at_pos(GST_DUMB_DEC(dec), pos))
 	{
 		GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
@@ -399,6 +475,110 @@ static GstClockTime gst_dumb_dec_tell(GstNonstreamAudioDecoder *dec)
 }
 
 
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static gboolean gst_dumb_dec_find_seek_points(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime *point_before, GstClockTime *point_after)
+{
+	long pos, before, after;
+	DUMB_IT_SIGDATA *itsd;
+	GstDumbDec *dumb_dec = GST_DUMB_DEC(dec);
+
+	if (dumb_dec->duh == NULL)
+		return FALSE;
+
+	itsd = duh_get_it_sigdata(dumb_dec->duh);
+	if ((itsd == NULL) || (itsd->checkpoint == NULL))
+		return FALSE;
+
+	/* Starting a sigrenderer at a checkpoint is cheap, since DUMB
+	 * then only has to copy the sigrenderer state stored in the
+	 * checkpoint, instead of rendering everything between the
+	 * checkpoint and the seek position. */
+	pos = gst_util_uint64_scale_int(position, 65536, GST_SECOND) + dumb_dec->cur_subsong_start_pos;
+	before = gst_dumb_dec_find_checkpoints(dumb_dec, pos, &after);
+
+	*point_before = gst_util_uint64_scale_int(before - dumb_dec->cur_subsong_start_pos, GST_SECOND, 65536);
+	*point_after = (after >= 0) ? gst_util_uint64_scale_int(after - dumb_dec->cur_subsong_start_pos, GST_SECOND, 65536) : GST_CLOCK_TIME_NONE;
+
+	return TRUE;
+}
+#endif
+
+
+static long gst_dumb_dec_find_checkpoints(GstDumbDec *dumb_dec, long pos, long *checkpoint_after)
+{
+	/* Returns the time of the last checkpoint at or before pos inside
+	 * the current subsong, and the time of the first one after pos
+	 * (or -1 if there is none). The subsong start counts as a checkpoint
+	 * as well. The checkpoint list is sorted by time. */
+
+	long before, after;
+	DUMB_IT_SIGDATA *itsd;
+	IT_CHECKPOINT *checkpoint;
+
+	before = dumb_dec->cur_subsong_start_pos;
+	after = -1;
+
+	itsd = duh_get_it_sigdata(dumb_dec->duh);
+
+	for (checkpoint = (itsd != NULL) ? itsd->checkpoint : NULL; checkpoint != NULL; checkpoint = checkpoint->next)
+	{
+		if (checkpoint->time < dumb_dec->cur_subsong_start_pos)
+			continue;
+		if ((checkpoint->time - dumb_dec->cur_subsong_start_pos) > dumb_dec->cur_subsong_info->length)
+			break;
+
+		if (checkpoint->time <= pos)
+			before = checkpoint->time;
+		else
+		{
+			after = checkpoint->time;
+			break;
+		}
+	}
+
+	if (checkpoint_after != NULL)
+		*checkpoint_after = after;
+
+	return before;
+}
+
+
+static gboolean gst_dumb_dec_skip_to_pos(GstDumbDec *dumb_dec, long seek_pos)
+{
+	/* A new sigrenderer created by duh_start_sigrenderer() starts at the
+	 * nearest checkpoint before the seek position, and then skips ahead
+	 * to it. If the current sigrenderer is already past that checkpoint,
+	 * but not past the seek position, it is cheaper to keep it and skip
+	 * ahead from where it is. This is typical for scrubbing, which
+	 * produces lots of short forward seeks. */
+
+	long cur_pos, checkpoint_pos;
+
+	if (dumb_dec->duh_sigrenderer == NULL)
+		return FALSE;
+
+	cur_pos = duh_sigrenderer_get_position(dumb_dec->duh_sigrenderer);
+	if (cur_pos > seek_pos)
+		return FALSE;
+
+	checkpoint_pos = gst_dumb_dec_find_checkpoints(dumb_dec, seek_pos, NULL);
+	if (cur_pos < checkpoint_pos)
+		return FALSE;
+
+	GST_DEBUG_OBJECT(dumb_dec, "skipping ahead from position %ld to %ld instead of restarting at checkpoint %ld", cur_pos, seek_pos, checkpoint_pos);
+
+	/* With a NULL sample buffer, DUMB only advances the playback
+	 * state without mixing anything; with a delta of 1, the size
+	 * is given in DUMB position units */
+	if (seek_pos > cur_pos)
+		duh_sigrenderer_generate_samples(dumb_dec->duh_sigrenderer, 0.0f, 1.0f, seek_pos - cur_pos, NULL);
+
+	dumb_dec->loop_end_reached = FALSE;
+
+	return TRUE;
+}
+
+
 static guint gst_dumb_dec_check_initial_subsong_index(GstDumbDec *dumb_dec, guint initial_subsong)
 {
 	if (initial_subsong >= dumb_dec->num_subsongs)
@@ -416,9 +596,19 @@ static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, Gst
 	gboolean ret;
 	GstDumbDec *dumb_dec = GST_DUMB_DEC(dec);
 
+	dumb_dec->sample_format = DEFAULT_SAMPLE_FORMAT;
 	dumb_dec->sample_rate = DEFAULT_SAMPLE_RATE;
 	dumb_dec->num_channels = DEFAULT_NUM_CHANNELS;
-	gst_nonstream_audio_decoder_get_downstream_info(dec, NULL, &(dumb_dec->sample_rate), &(dumb_dec->num_channels));
+	gst_nonstream_audio_decoder_get_downstream_info(dec, &(dumb_dec->sample_format), &(dumb_dec->sample_rate), &(dumb_dec->num_channels));
+
+	/* the sample buffer is allocated for a specific channel count,
+	 * which might have changed */
+	if (dumb_dec->sample_buffer != NULL)
+	{
+		destroy_sample_buffer(dumb_dec->sample_buffer);
+		dumb_dec->sample_buffer = NULL;
+		dumb_dec->sample_buffer_size = 0;
+	}
 
 	{
 		GstMapInfo map;
@@ -431,6 +621,7 @@ static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, Gst
 			DUH *psm_duh;
 
 			dumb_dec->subsongs = NULL;
+			dumb_dec->duh = NULL;
 
 			dumbfile = dumbfile_open_memory((char const *)(map.data), map.size);
 			num_psm_subsongs = dumb_get_psm_subsong_count(dumbfile);
@@ -444,32 +635,68 @@ static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, Gst
 				g_array_set_size(dumb_dec->subsongs, num_psm_subsongs);
 				subsong_info = (gst_dumb_dec_subsong_info *)(dumb_dec->subsongs->data);
 
+				dumb_dec->subsongs_explicit = TRUE;
+				dumb_dec->num_subsongs = num_psm_subsongs;
+				initial_subsong = gst_dumb_dec_check_initial_subsong_index(dumb_dec, initial_subsong);
+
+				/* DUMB's PSM reader can only produce a subsong's order list as part
+				 * of reading the entire module, so each subsong has to be read once.
+				 * Use the quick reader, which skips DUMB's initial run-through, and
+				 * do exactly one run-through per subsong to get its length (and the
+				 * seek checkpoints). The initial subsong's DUH is then kept for
+				 * playback instead of being read yet another time. */
 				for (subsong_idx = 0; subsong_idx < num_psm_subsongs; ++subsong_idx)
 				{
 					dumbfile = dumbfile_open_memory((char const *)(map.data), map.size);
-					psm_duh = dumb_read_any(dumbfile, 0/*restrict_*/, subsong_idx);
+					psm_duh = dumb_read_any_quick(dumbfile, 0/*restrict_*/, subsong_idx);
+					dumbfile_close(dumbfile);
+
 					if (psm_duh != NULL)
 					{
-						long len = dumb_it_build_checkpoints(duh_get_it_sigdata(psm_duh), 0);
-						GST_DEBUG_OBJECT(dumb_dec, "subsong %d: length %ld", subsong_idx, len);
-						unload_duh(psm_duh);
+						if (dumb_it_do_initial_runthrough(psm_duh) < 0)
+						{
+							unload_duh(psm_duh);
+							if (dumb_dec->duh != NULL)
+							{
+								unload_duh(dumb_dec->duh);
+								dumb_dec->duh = NULL;
+							}
+							g_array_free(dumb_dec->subsongs, TRUE);
+							dumb_dec->subsongs = NULL;
+
+							gst_buffer_unmap(source_data, &map);
+
+							GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+							GST_ELEMENT_ERROR(dumb_dec, STREAM, DECODE, (NULL), ("DUMB failed to do the initial run-through of subsong %d", subsong_idx));
+							GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+							return FALSE;
+						}
+
 						subsong_info[subsong_idx].start_order = 0;
-						subsong_info[subsong_idx].length = len;
+						subsong_info[subsong_idx].length = duh_get_length(psm_duh);
+						GST_DEBUG_OBJECT(dumb_dec, "subsong %d: length %ld", subsong_idx, subsong_info[subsong_idx].length);
+
+						if ((guint)subsong_idx == initial_subsong)
+							dumb_dec->duh = psm_duh;
+						else
+							unload_duh(psm_duh);
+					}
+					else
+					{
+						subsong_info[subsong_idx].start_order = 0;
+						subsong_info[subsong_idx].length = 0;
 					}
-					dumbfile_close(dumbfile);
 				}
-
-				dumb_dec->subsongs_explicit = TRUE;
-				dumb_dec->num_subsongs = num_psm_subsongs;
-				initial_subsong = gst_dumb_dec_check_initial_subsong_index(dumb_dec, initial_subsong);
 			}
 		}
 
-		dumbfile = dumbfile_open_memory((char const *)(map.data), map.size);
-
-		dumb_dec->duh = dumb_read_any(dumbfile, 0/*restrict_*/, dumb_dec->subsongs_explicit ? initial_subsong : (guint)0);
+		if (dumb_dec->duh == NULL)
+		{
+			dumbfile = dumbfile_open_memory((char const *)(map.data), map.size);
+			dumb_dec->duh = dumb_read_any(dumbfile, 0/*restrict_*/, dumb_dec->subsongs_explicit ? initial_subsong : (guint)0);
+			dumbfile_close(dumbfile);
+		}
 
-		dumbfile_close(dumbfile);
 		gst_buffer_unmap(source_data, &map);
 
 		if (dumb_dec->duh == NULL)
@@ -493,6 +720,13 @@ static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, Gst
 	{
 		GST_INFO_OBJECT(dumb_dec, "song data does not contain subsong information - searching for subsongs by scanning");
 		gst_dumb_scan_for_subsongs(dumb_dec);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+		if (gst_nonstream_audio_decoder_is_loading_cancelled(dec))
+		{
+			GST_DEBUG_OBJECT(dumb_dec, "loading was cancelled during the subsong scan");
+			return FALSE;
+		}
+#endif
 		if (dumb_dec->subsongs == NULL)
 			dumb_dec->subsongs = g_array_new(FALSE, FALSE, sizeof(gst_dumb_dec_subsong_info));
 		GST_INFO_OBJECT(dumb_dec, "found %u subsongs by scanning", dumb_dec->subsongs->len);
@@ -518,7 +752,14 @@ static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, Gst
 	dumb_dec->cur_subsong_info = &g_array_index(dumb_dec->subsongs, gst_dumb_dec_subsong_info, initial_subsong);
 	dumb_dec->cur_subsong_start_pos = 0;
 
-	if (dumb_dec->cur_subsong_info->start_order == 0)
+	if (dec->metadata_only)
+	{
+		/* nothing is rendered in metadata-only mode,
+		 * so there is no need for a sigrenderer */
+		GST_DEBUG_OBJECT(dumb_dec, "metadata-only mode - not initializing sigrenderer");
+		ret = TRUE;
+	}
+	else if (dumb_dec->cur_subsong_info->start_order == 0)
 	{
 		ret = gst_dumb_dec_init_sigrenderer_at_pos(dumb_dec, 0);
 		dumb_dec->cur_subsong_start_pos = 0;
@@ -544,7 +785,7 @@ static gboolean gst_dumb_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, Gst
 	if (!gst_nonstream_audio_decoder_set_output_format_simple(
 		dec,
 		dumb_dec->sample_rate,
-		GST_AUDIO_FORMAT_S16,
+		dumb_dec->sample_format,
 		dumb_dec->num_channels
 	))
 		return FALSE;
@@ -684,15 +925,32 @@ static gboolean gst_dumb_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer **b
 			gst_nonstream_audio_decoder_handle_loop(dec, gst_dumb_dec_tell(dec));
 	}
 
+	if (g_signal_has_handler_pending(dumb_dec, gst_dumb_dec_signals[SIGNAL_RENDER_CHUNK], 0, FALSE))
+	{
+		guint64 position = gst_dumb_dec_tell(dec);
+
+		/* the handler may access properties, and the base class property
+		 * accessors take the decoder lock, so do not emit with it held */
+		GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+		g_signal_emit(dumb_dec, gst_dumb_dec_signals[SIGNAL_RENDER_CHUNK], 0, position);
+		GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+	}
+
+	gst_dumb_dec_update_render_settings(dumb_dec);
+
 	num_samples_per_outbuf = 1024;
-	num_bytes_per_outbuf = num_samples_per_outbuf * dumb_dec->num_channels * RENDER_BIT_DEPTH / 8;
+	num_bytes_per_outbuf = num_samples_per_outbuf * GST_AUDIO_INFO_BPF(&(dec->output_audio_info));
 
 	outbuf = gst_nonstream_audio_decoder_allocate_output_buffer(dec, num_bytes_per_outbuf);
 	if (G_UNLIKELY(outbuf == NULL))
 		return FALSE;
 
+	/* remember where this render call started, so the voice
+	 * sigrenderers can be set up at the same position */
+	dumb_dec->render_start_pos = duh_sigrenderer_get_position(dumb_dec->duh_sigrenderer);
+
 	gst_buffer_map(outbuf, &map, GST_MAP_WRITE);
-	actual_num_samples_read = duh_render(dumb_dec->duh_sigrenderer, RENDER_BIT_DEPTH, 0, 1.0f, 65536.0f / dumb_dec->sample_rate, num_samples_per_outbuf, map.data);
+	actual_num_samples_read = gst_dumb_dec_render(dumb_dec, dumb_dec->duh_sigrenderer, num_samples_per_outbuf, map.data);
 	gst_buffer_unmap(outbuf, &map);
 
 	if (actual_num_samples_read == 0)
@@ -704,7 +962,7 @@ static gboolean gst_dumb_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer **b
 	else
 	{
 		if (actual_num_samples_read != num_samples_per_outbuf)
-			gst_buffer_set_size(outbuf, actual_num_samples_read * dumb_dec->num_channels * RENDER_BIT_DEPTH / 8);
+			gst_buffer_set_size(outbuf, actual_num_samples_read * GST_AUDIO_INFO_BPF(&(dec->output_audio_info)));
 
 		*buffer = outbuf;
 		*num_samples = actual_num_samples_read;
@@ -714,6 +972,228 @@ static gboolean gst_dumb_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer **b
 }
 
 
+static long gst_dumb_dec_render(GstDumbDec *dumb_dec, DUH_SIGRENDERER *sigrenderer, long num_samples, gpointer dest)
+{
+	long num_rendered;
+
+	/* Render into DUMB's own sample buffer instead of using duh_render(),
+	 * since duh_render() can only produce 8- and 16-bit integer samples,
+	 * which would throw away most of the precision of DUMB's mixer */
+	if (dumb_dec->sample_buffer_size < num_samples)
+	{
+		if (dumb_dec->sample_buffer != NULL)
+			destroy_sample_buffer(dumb_dec->sample_buffer);
+
+		dumb_dec->sample_buffer = allocate_sample_buffer(dumb_dec->num_channels, num_samples);
+		if (dumb_dec->sample_buffer == NULL)
+		{
+			GST_ERROR_OBJECT(dumb_dec, "could not allocate sample buffer for %ld samples", num_samples);
+			dumb_dec->sample_buffer_size = 0;
+			return 0;
+		}
+
+		dumb_dec->sample_buffer_size = num_samples;
+	}
+
+	/* DUMB adds the rendered samples to the buffer contents */
+	dumb_silence(dumb_dec->sample_buffer[0], dumb_dec->num_channels * num_samples);
+	num_rendered = duh_sigrenderer_generate_samples(sigrenderer, 1.0f, 65536.0f / dumb_dec->sample_rate, num_samples, dumb_dec->sample_buffer);
+
+	switch (dumb_dec->sample_format)
+	{
+		case GST_AUDIO_FORMAT_F32:
+			gst_dumb_dec_convert_to_f32((gfloat *)dest, dumb_dec->sample_buffer[0], num_rendered * dumb_dec->num_channels);
+			break;
+		case GST_AUDIO_FORMAT_S32:
+			gst_dumb_dec_convert_to_s32((gint32 *)dest, dumb_dec->sample_buffer[0], num_rendered * dumb_dec->num_channels);
+			break;
+		case GST_AUDIO_FORMAT_S16:
+			gst_dumb_dec_convert_to_s16((gint16 *)dest, dumb_dec->sample_buffer[0], num_rendered * dumb_dec->num_channels);
+			break;
+		default:
+			g_assert_not_reached();
+	}
+
+	return num_rendered;
+}
+
+
+static void gst_dumb_dec_convert_to_f32(gfloat *dest, sample_t const *src, long num_values)
+{
+	long i = 0;
+
+	/* no clipping necessary, since floating point samples can exceed the
+	 * -1.0 .. 1.0 range; this preserves the headroom of DUMB's mixer */
+
+#if defined(_USE_SSE) && defined(__SSE2__)
+	{
+		__m128 const scale = _mm_set1_ps(1.0f / DUMB_SAMPLE_SCALE);
+		for (; (i + 4) <= num_values; i += 4)
+			_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i const *)(src + i))), scale));
+	}
+#endif
+
+	for (; i < num_values; ++i)
+		dest[i] = src[i] * (1.0f / DUMB_SAMPLE_SCALE);
+}
+
+
+static void gst_dumb_dec_convert_to_s32(gint32 *dest, sample_t const *src, long num_values)
+{
+	long i;
+
+	for (i = 0; i < num_values; ++i)
+		dest[i] = (gint32)((guint32)CLAMP(src[i], -0x800000, 0x7FFFFF) << 8);
+}
+
+
+static void gst_dumb_dec_convert_to_s16(gint16 *dest, sample_t const *src, long num_values)
+{
+	long i;
+
+	/* same rounding as duh_render() */
+	for (i = 0; i < num_values; ++i)
+		dest[i] = (gint16)CLAMP((src[i] + 0x80) >> 8, -0x8000, 0x7FFF);
+}
+
+
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static guint gst_dumb_dec_get_num_voices(GstNonstreamAudioDecoder *dec)
+{
+	GstDumbDec *dumb_dec = GST_DUMB_DEC(dec);
+	DUMB_IT_SIGDATA *itsd;
+
+	if (dumb_dec->duh == NULL)
+		return 0;
+
+	itsd = duh_get_it_sigdata(dumb_dec->duh);
+	return (itsd != NULL) ? (guint)(itsd->n_pchannels) : 0;
+}
+
+
+static gboolean gst_dumb_dec_decode_voices(GstNonstreamAudioDecoder *dec, guint const *voices, GstBuffer **buffers, guint num_voices, guint num_samples)
+{
+	GstDumbDec *dumb_dec;
+	guint i, num_bytes;
+	GstMapInfo map;
+
+	dumb_dec = GST_DUMB_DEC(dec);
+
+	/* DUMB has no per-channel outputs, so each voice gets a sigrenderer
+	 * of its own, with all other channels muted. These sigrenderers
+	 * follow the main one; if the main one was recreated (because of a
+	 * seek or subsong switch), they have to be recreated as well. */
+	if (dumb_dec->voice_sigrenderers_stale)
+	{
+		gst_dumb_dec_end_voice_sigrenderers(dumb_dec);
+		dumb_dec->voice_sigrenderers_stale = FALSE;
+	}
+
+	num_bytes = num_samples * GST_AUDIO_INFO_BPF(&(dec->output_audio_info));
+
+	for (i = 0; i < num_voices; ++i)
+	{
+		guint voice = voices[i];
+		DUH_SIGRENDERER *voice_sr;
+		long num_rendered;
+
+		if (voice >= dumb_dec->voice_sigrenderers->len)
+			g_ptr_array_set_size(dumb_dec->voice_sigrenderers, voice + 1);
+
+		/* A voice sigrenderer that is not at the expected position
+		 * missed render calls (because its pad was released and
+		 * requested again, for example); restart it */
+		voice_sr = g_ptr_array_index(dumb_dec->voice_sigrenderers, voice);
+		if ((voice_sr != NULL) && (duh_sigrenderer_get_position(voice_sr) != dumb_dec->render_start_pos))
+		{
+			duh_end_sigrenderer(voice_sr);
+			voice_sr = NULL;
+		}
+
+		if (voice_sr == NULL)
+		{
+			voice_sr = gst_dumb_dec_start_voice_sigrenderer(dumb_dec, voice);
+			if (voice_sr == NULL)
+			{
+				GST_ERROR_OBJECT(dumb_dec, "could not start sigrenderer for voice %u", voice);
+				return FALSE;
+			}
+			g_ptr_array_index(dumb_dec->voice_sigrenderers, voice) = voice_sr;
+		}
+
+		buffers[i] = gst_nonstream_audio_decoder_allocate_output_buffer(dec, num_bytes);
+		if (G_UNLIKELY(buffers[i] == NULL))
+			return FALSE;
+
+		gst_buffer_map(buffers[i], &map, GST_MAP_WRITE);
+		num_rendered = gst_dumb_dec_render(dumb_dec, voice_sr, num_samples, map.data);
+		/* Voice sigrenderers have no loop callbacks installed, so they
+		 * keep playing where the main sigrenderer ends; num_samples is
+		 * what the main one produced, so they normally fill the buffer.
+		 * They only fall short if DUMB itself ends the voice early (if
+		 * rendering fails, for example); pad the rest with silence in
+		 * that case. */
+		if (num_rendered < (long)num_samples)
+		{
+			guint num_rendered_bytes = num_rendered * GST_AUDIO_INFO_BPF(&(dec->output_audio_info));
+			GST_DEBUG_OBJECT(dumb_dec, "voice %u ended early (%ld of %u samples rendered) - padding with silence", voice, num_rendered, num_samples);
+			memset(map.data + num_rendered_bytes, 0, num_bytes - num_rendered_bytes);
+		}
+		gst_buffer_unmap(buffers[i], &map);
+	}
+
+	return TRUE;
+}
+
+
+static DUH_SIGRENDERER* gst_dumb_dec_start_voice_sigrenderer(GstDumbDec *dumb_dec, guint voice)
+{
+	DUH_SIGRENDERER *voice_sr;
+	DUMB_IT_SIGRENDERER *itsr;
+	int channel;
+
+	/* Start at the same position the main sigrenderer was at
+	 * before its last render call. If that is the start of a subsong
+	 * which does not begin at order 0, start at its order instead,
+	 * like gst_dumb_dec_set_current_subsong() does. */
+	if ((dumb_dec->render_start_pos == dumb_dec->cur_subsong_start_pos) && (dumb_dec->cur_subsong_info->start_order != 0))
+		voice_sr = dumb_it_start_at_order(dumb_dec->duh, dumb_dec->num_channels, dumb_dec->cur_subsong_info->start_order);
+	else
+		voice_sr = duh_start_sigrenderer(dumb_dec->duh, 0, dumb_dec->num_channels, dumb_dec->render_start_pos);
+
+	if (voice_sr == NULL)
+		return NULL;
+
+	gst_dumb_dec_apply_render_settings(dumb_dec, voice_sr);
+
+	itsr = duh_get_it_sigrenderer(voice_sr);
+
+	for (channel = 0; channel < DUMB_IT_N_CHANNELS; ++channel)
+		dumb_it_sr_set_channel_muted(itsr, channel, (channel != (int)voice));
+
+	GST_DEBUG_OBJECT(dumb_dec, "started sigrenderer for voice %u at position %ld", voice, dumb_dec->render_start_pos);
+
+	return voice_sr;
+}
+#endif
+
+
+static void gst_dumb_dec_end_voice_sigrenderers(GstDumbDec *dumb_dec)
+{
+	guint i;
+
+	for (i = 0; i < dumb_dec->voice_sigrenderers->len; ++i)
+	{
+		DUH_SIGRENDERER *voice_sr = g_ptr_array_index(dumb_dec->voice_sigrenderers, i);
+		if (voice_sr != NULL)
+		{
+			duh_end_sigrenderer(voice_sr);
+			g_ptr_array_index(dumb_dec->voice_sigrenderers, i) = NULL;
+		}
+	}
+}
+
+
 static int gst_dumb_dec_loop_callback(void *ptr)
 {
 	gboolean continue_loop;
@@ -806,13 +1286,13 @@ static void gst_dumb_dec_init_sigrenderer_common(GstDumbDec *dumb_dec)
 {
 	dumb_dec->cur_loop_count = 0;
 	dumb_dec->loop_end_reached = FALSE;
+	dumb_dec->voice_sigrenderers_stale = TRUE;
+
+	gst_dumb_dec_apply_render_settings(dumb_dec, dumb_dec->duh_sigrenderer);
 
 	{
 		DUMB_IT_SIGRENDERER *itsr = duh_get_it_sigrenderer(dumb_dec->duh_sigrenderer);
 
-		dumb_it_set_resampling_quality(itsr, dumb_dec->resampling_quality);
-		dumb_it_set_ramp_style(itsr, dumb_dec->ramp_style);
-
 		dumb_it_set_loop_callback(itsr, &gst_dumb_dec_loop_callback, dumb_dec);
 		dumb_it_set_xm_speed_zero_callback(itsr, &gst_dumb_dec_loop_callback, dumb_dec);
 		dumb_it_set_global_volume_zero_callback(itsr, &gst_dumb_dec_loop_callback, dumb_dec);
@@ -820,6 +1300,36 @@ static void gst_dumb_dec_init_sigrenderer_common(GstDumbDec *dumb_dec)
 }
 
 
+static void gst_dumb_dec_apply_render_settings(GstDumbDec *dumb_dec, DUH_SIGRENDERER *sigrenderer)
+{
+	DUMB_IT_SIGRENDERER *itsr = duh_get_it_sigrenderer(sigrenderer);
+
+	dumb_it_set_resampling_quality(itsr, g_atomic_int_get(&(dumb_dec->resampling_quality)));
+	dumb_it_set_ramp_style(itsr, g_atomic_int_get(&(dumb_dec->ramp_style)));
+}
+
+
+static void gst_dumb_dec_update_render_settings(GstDumbDec *dumb_dec)
+{
+	guint i;
+
+	/* apply any settings staged by the property setters since the last chunk */
+	if (!g_atomic_int_compare_and_exchange(&(dumb_dec->render_settings_changed), 1, 0))
+		return;
+
+	GST_DEBUG_OBJECT(dumb_dec, "applying new render settings: resampling quality %d ramp style %d", g_atomic_int_get(&(dumb_dec->resampling_quality)), g_atomic_int_get(&(dumb_dec->ramp_style)));
+
+	gst_dumb_dec_apply_render_settings(dumb_dec, dumb_dec->duh_sigrenderer);
+
+	for (i = 0; i < dumb_dec->voice_sigrenderers->len; ++i)
+	{
+		DUH_SIGRENDERER *voice_sr = g_ptr_array_index(dumb_dec->voice_sigrenderers, i);
+		if (voice_sr != NULL)
+			gst_dumb_dec_apply_render_settings(dumb_dec, voice_sr);
+	}
+}
+
+
 static gboolean dumb_it_test_for_speed_and_tempo( DUMB_IT_SIGDATA * itsd )
 {
 	unsigned char pattern_tested[ 256 ];
@@ -879,12 +1389,30 @@ typedef struct
 } gst_dumb_subsong_scan_context;
 
 
+typedef struct
+{
+	gst_dumb_subsong_scan_context ctx;
+	DUMB_IT_SIGDATA *itsd;
+	int result;
+} gst_dumb_subsong_scan_job;
+
+
 static int gst_dumb_scan_callback(void *context, int order, long length)
 {
 	gst_dumb_subsong_scan_context *ctx;
 	gst_dumb_dec_subsong_info info;
 	
 	ctx = (gst_dumb_subsong_scan_context *)context;
+
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	/* a negative return value makes DUMB abort the scan */
+	if (gst_nonstream_audio_decoder_is_loading_cancelled(GST_NONSTREAM_AUDIO_DECODER(ctx->dumb_dec)))
+	{
+		GST_DEBUG_OBJECT(ctx->dumb_dec, "loading was cancelled - aborting subsong scan");
+		return -1;
+	}
+#endif
+
 	GST_DEBUG_OBJECT(ctx->dumb_dec, "found subsong in scan callback: order %d length %ld", order, length);
 
 	info.start_order = order;
@@ -896,6 +1424,50 @@ static int gst_dumb_scan_callback(void *context, int order, long length)
 }
 
 
+static gpointer gst_dumb_scan_thread_func(gpointer data)
+{
+	gst_dumb_subsong_scan_job *job = (gst_dumb_subsong_scan_job *)data;
+	job->result = dumb_it_scan_for_playable_orders(job->itsd, gst_dumb_scan_callback, &(job->ctx));
+	return NULL;
+}
+
+
+static DUMB_IT_SIGDATA* gst_dumb_copy_sigdata_patterns(DUMB_IT_SIGDATA const *itsd)
+{
+	/* Creates a shallow copy of the sigdata with its own copies of the
+	 * patterns. Everything else (orders, samples, instruments ...) is
+	 * shared, since neither scanning nor the tempo conversion modify it. */
+
+	int i;
+	DUMB_IT_SIGDATA *copy;
+
+	copy = g_new(DUMB_IT_SIGDATA, 1);
+	memcpy(copy, itsd, sizeof(DUMB_IT_SIGDATA));
+
+	copy->pattern = g_new(IT_PATTERN, itsd->n_patterns);
+	for (i = 0; i < itsd->n_patterns; ++i)
+	{
+		IT_PATTERN const *pat = &(itsd->pattern[i]);
+		copy->pattern[i] = *pat;
+		copy->pattern[i].entry = g_new(IT_ENTRY, pat->n_entries);
+		memcpy(copy->pattern[i].entry, pat->entry, sizeof(IT_ENTRY) * pat->n_entries);
+	}
+
+	return copy;
+}
+
+
+static void gst_dumb_free_sigdata_patterns(DUMB_IT_SIGDATA *copy)
+{
+	int i;
+
+	for (i = 0; i < copy->n_patterns; ++i)
+		g_free(copy->pattern[i].entry);
+	g_free(copy->pattern);
+	g_free(copy);
+}
+
+
 static void gst_dumb_scan_for_subsongs(GstDumbDec *dumb_dec)
 {
 	char const *format;
@@ -903,67 +1475,94 @@ static void gst_dumb_scan_for_subsongs(GstDumbDec *dumb_dec)
 	int is_mod;
 	gst_dumb_subsong_scan_context ctx;
 	GArray *subsongs;
+	DUMB_IT_SIGDATA *itsd;
 
 	subsongs = g_array_new(FALSE, FALSE, sizeof(gst_dumb_dec_subsong_info));
 
 	ctx.dumb_dec = dumb_dec;
 	ctx.subsongs = subsongs;
 
+	itsd = duh_get_it_sigdata(dumb_dec->duh);
 	format = duh_get_tag(dumb_dec->duh, "FORMAT");
-	start_order = dumb_it_scan_for_playable_orders(duh_get_it_sigdata(dumb_dec->duh), gst_dumb_scan_callback, &ctx);
-
 	is_mod = (strcmp(format, "MOD") == 0);
 
-	if (!start_order && is_mod)
+	if (is_mod && !dumb_it_test_for_speed_and_tempo(itsd))
 	{
-		DUMB_IT_SIGDATA *itsd = duh_get_it_sigdata(dumb_dec->duh);
-
-		GST_DEBUG_OBJECT(dumb_dec, "song format is MOD -> need to repeat scan because of tempo conversion");
-
-		if (!dumb_it_test_for_speed_and_tempo(itsd))
+		/* MOD files are ambiguous about the meaning of speed values above 0x20,
+		 * so the song has to be scanned twice, once with the original tempos and
+		 * once with tempos converted to vblank timing. Both scans are independent
+		 * of each other, so run the original-tempo scan in a separate thread, on
+		 * a copy of the patterns, while the real sigdata is converted and scanned
+		 * here. (The scan itself cannot be split further, since DUMB determines
+		 * subsong start orders by excluding the orders played by earlier ones.) */
+
+		gst_dumb_subsong_scan_job job;
+		GThread *scan_thread;
+		GError *error = NULL;
+		GArray *mod_subsongs;
+
+		GST_DEBUG_OBJECT(dumb_dec, "song format is MOD -> need to scan with both original and converted tempos");
+
+		job.ctx.dumb_dec = dumb_dec;
+		job.ctx.subsongs = subsongs;
+		job.itsd = gst_dumb_copy_sigdata_patterns(itsd);
+		job.result = -1;
+
+		scan_thread = g_thread_try_new("dumbdec-scan", gst_dumb_scan_thread_func, &job, &error);
+		if (scan_thread == NULL)
 		{
-			GArray *mod_subsongs;
-			mod_subsongs = g_array_new(FALSE, FALSE, sizeof(gst_dumb_dec_subsong_info));
-			ctx.subsongs = mod_subsongs;
+			GST_WARNING_OBJECT(dumb_dec, "could not create scan thread (%s) - scanning sequentially", error->message);
+			g_error_free(error);
+			gst_dumb_scan_thread_func(&job);
+		}
 
-			dumb_it_convert_tempos(itsd, TRUE);
-			start_order = dumb_it_scan_for_playable_orders(duh_get_it_sigdata(dumb_dec->duh), gst_dumb_scan_callback, &ctx);
-			if (!start_order)
-			{
-				guint i;
-				long total_length_original;
-				long total_length_vblank;
-				gst_dumb_dec_subsong_info *subsong_info;
-				gst_dumb_dec_subsong_info *mod_subsong_info;
+		mod_subsongs = g_array_new(FALSE, FALSE, sizeof(gst_dumb_dec_subsong_info));
+		ctx.subsongs = mod_subsongs;
 
-				total_length_original = 0;
-				total_length_vblank = 0;
-				subsong_info = (gst_dumb_dec_subsong_info *)(subsongs->data);
-				mod_subsong_info = (gst_dumb_dec_subsong_info *)(mod_subsongs->data);
+		dumb_it_convert_tempos(itsd, TRUE);
+		start_order = dumb_it_scan_for_playable_orders(itsd, gst_dumb_scan_callback, &ctx);
 
-				/* Safe to assume that both have the same song count as
-				   speed/tempo don't affect song flow control */
-				for (i = 0; i < subsongs->len; ++i)
-				{
-					total_length_original += subsong_info[i].length;
-					total_length_vblank += mod_subsong_info[i].length;
-				}
+		if (scan_thread != NULL)
+			g_thread_join(scan_thread);
+		gst_dumb_free_sigdata_patterns(job.itsd);
 
-				if (
-					(total_length_original != 0) ||
-					(
-						(total_length_vblank != 0) && (total_length_vblank < total_length_original)
-					)
-				)
-				{
-					for (i = 0; i < subsongs->len; ++i)
-						subsong_info[i].length = mod_subsong_info[i].length;
-				}
+		if (!job.result && !start_order)
+		{
+			guint i;
+			long total_length_original;
+			long total_length_vblank;
+			gst_dumb_dec_subsong_info *subsong_info;
+			gst_dumb_dec_subsong_info *mod_subsong_info;
+
+			total_length_original = 0;
+			total_length_vblank = 0;
+			subsong_info = (gst_dumb_dec_subsong_info *)(subsongs->data);
+			mod_subsong_info = (gst_dumb_dec_subsong_info *)(mod_subsongs->data);
+
+			/* Safe to assume that both have the same song count as
+			   speed/tempo don't affect song flow control */
+			for (i = 0; i < subsongs->len; ++i)
+			{
+				total_length_original += subsong_info[i].length;
+				total_length_vblank += mod_subsong_info[i].length;
 			}
 
-			g_array_free(mod_subsongs, TRUE);
+			if (
+				(total_length_original != 0) ||
+				(
+					(total_length_vblank != 0) && (total_length_vblank < total_length_original)
+				)
+			)
+			{
+				for (i = 0; i < subsongs->len; ++i)
+					subsong_info[i].length = mod_subsong_info[i].length;
+			}
 		}
+
+		g_array_free(mod_subsongs, TRUE);
 	}
+	else
+		dumb_it_scan_for_playable_orders(itsd, gst_dumb_scan_callback, &ctx);
 
 	dumb_dec->subsongs = subsongs;
 }
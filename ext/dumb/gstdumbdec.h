@@ -31,13 +31,21 @@ struct _GstDumbDec
 {
 	GstNonstreamAudioDecoder parent;
 
+	GstAudioFormat sample_format;
 	gint sample_rate, num_channels;
 
+	sample_t **sample_buffer;
+	long sample_buffer_size;
+
 	gint cur_loop_count, num_loops;
 	gboolean loop_end_reached;
 	gboolean do_actual_looping;
 
-	gint resampling_quality, ramp_style;
+	/* render settings are staged by the property setters without taking
+	 * the decoder lock, and applied by the streaming thread at the start
+	 * of the next chunk (access these with the g_atomic_int functions) */
+	volatile gint resampling_quality, ramp_style;
+	volatile gint render_settings_changed;
 
 	DUH *duh;
 	DUH_SIGRENDERER *duh_sigrenderer;
@@ -48,6 +56,10 @@ struct _GstDumbDec
 	gboolean subsongs_explicit;
 	long cur_subsong_start_pos;
 
+	GPtrArray *voice_sigrenderers;
+	gboolean voice_sigrenderers_stale;
+	long render_start_pos;
+
 };
 
 
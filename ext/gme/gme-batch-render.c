@@ -0,0 +1,199 @@
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include "gstgmebatch.h"
+#include "gstgmeloader.h"
+
+
+/* Renders all tracks of a GME-supported music file to WAV files,
+ * using gst_gme_batch_render(). Each track is written to
+ * <output prefix>-<track number>.wav . */
+
+
+typedef struct
+{
+	FILE *file;
+	guint32 num_data_bytes;
+	gboolean write_error;
+}
+output_wav;
+
+
+static gint sample_rate = 48000;
+static gint num_loops = 1;
+static gint num_threads = 0;
+static gboolean enable_accuracy = FALSE;
+
+
+static GOptionEntry option_entries[] =
+{
+	{ "rate", 'r', 0, G_OPTION_ARG_INT, &sample_rate, "Output sample rate", "RATE" },
+	{ "loops", 'l', 0, G_OPTION_ARG_INT, &num_loops, "Number of loops to render (-1 = use the play length)", "LOOPS" },
+	{ "accuracy", 'a', 0, G_OPTION_ARG_NONE, &enable_accuracy, "Use accurate sound emulation", NULL },
+	{ "threads", 'j', 0, G_OPTION_ARG_INT, &num_threads, "Number of render threads (0 = one per processor)", "THREADS" },
+	{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+
+static gboolean write_wav_header(output_wav *wav);
+static gboolean write_samples(guint track, gint16 const *samples, gsize num_samples, gpointer user_data);
+
+
+
+static gboolean write_wav_header(output_wav *wav)
+{
+	guint8 header[44];
+	guint32 val32;
+	guint16 val16;
+
+#define SET_32(OFS, VAL) val32 = GUINT32_TO_LE(VAL); memcpy(header + (OFS), &val32, 4);
+#define SET_16(OFS, VAL) val16 = GUINT16_TO_LE(VAL); memcpy(header + (OFS), &val16, 2);
+
+	memcpy(header + 0, "RIFF", 4);
+	SET_32(4, 36 + wav->num_data_bytes);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	SET_32(16, 16);
+	SET_16(20, 1); /* PCM */
+	SET_16(22, 2); /* channels */
+	SET_32(24, sample_rate);
+	SET_32(28, sample_rate * 2 * 2); /* byte rate */
+	SET_16(32, 2 * 2); /* block align */
+	SET_16(34, 16); /* bits per sample */
+	memcpy(header + 36, "data", 4);
+	SET_32(40, wav->num_data_bytes);
+
+#undef SET_32
+#undef SET_16
+
+	return (fseek(wav->file, 0, SEEK_SET) == 0) && (fwrite(header, 1, sizeof(header), wav->file) == sizeof(header));
+}
+
+
+static gboolean write_samples(guint track, gint16 const *samples, gsize num_samples, gpointer user_data)
+{
+	/* all tracks are rendered, so the track number is also the index */
+	output_wav *wav = &(((output_wav *)user_data)[track]);
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	gsize i;
+	for (i = 0; i < num_samples; ++i)
+	{
+		gint16 sample = GINT16_TO_LE(samples[i]);
+		if (fwrite(&sample, 2, 1, wav->file) != 1)
+			break;
+	}
+	wav->write_error = (i != num_samples);
+#else
+	wav->write_error = (fwrite(samples, 2, num_samples, wav->file) != num_samples);
+#endif
+
+	if (wav->write_error)
+		return FALSE;
+
+	wav->num_data_bytes += num_samples * 2;
+	return TRUE;
+}
+
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *option_context;
+	GError *error = NULL;
+	gchar *data;
+	gsize size;
+	gme_t *emu;
+	gme_err_t err;
+	guint num_tracks, i;
+	guint *tracks;
+	output_wav *wavs;
+	gme_err_t *track_errors;
+	int ret = 0;
+
+	option_context = g_option_context_new("FILE OUTPUT-PREFIX - render all tracks of a music file to WAV files");
+	g_option_context_add_main_entries(option_context, option_entries, NULL);
+	if (!g_option_context_parse(option_context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(option_context);
+		return 1;
+	}
+	g_option_context_free(option_context);
+
+	if ((argc != 3) || (sample_rate <= 0) || (num_threads < 0))
+	{
+		g_printerr("Usage: %s [OPTION...] FILE OUTPUT-PREFIX\n", argv[0]);
+		return 1;
+	}
+
+	if (!g_file_get_contents(argv[1], &data, &size, &error))
+	{
+		g_printerr("Could not read %s: %s\n", argv[1], error->message);
+		g_error_free(error);
+		return 1;
+	}
+
+	/* only used for finding out the number of tracks */
+	err = gst_gme_open_mem(data, size, &emu, sample_rate);
+	if (err != NULL)
+	{
+		g_printerr("Could not open %s: %s\n", argv[1], err);
+		g_free(data);
+		return 1;
+	}
+	num_tracks = gme_track_count(emu);
+	gme_delete(emu);
+
+	tracks = g_new(guint, num_tracks);
+	wavs = g_new0(output_wav, num_tracks);
+	track_errors = g_new0(gme_err_t, num_tracks);
+
+	for (i = 0; i < num_tracks; ++i)
+	{
+		gchar *filename = g_strdup_printf("%s-%03u.wav", argv[2], i + 1);
+
+		tracks[i] = i;
+		wavs[i].file = fopen(filename, "wb");
+		if ((wavs[i].file == NULL) || !write_wav_header(&(wavs[i])))
+		{
+			g_printerr("Could not create %s\n", filename);
+			g_free(filename);
+			ret = 1;
+			goto cleanup;
+		}
+
+		g_free(filename);
+	}
+
+	if (!gst_gme_batch_render(data, size, tracks, num_tracks, sample_rate, num_loops, enable_accuracy, num_threads, write_samples, wavs, track_errors))
+		ret = 1;
+
+	for (i = 0; i < num_tracks; ++i)
+	{
+		if (track_errors[i] != NULL)
+			g_printerr("Track %u: %s\n", i + 1, wavs[i].write_error ? "write error" : track_errors[i]);
+		else if (!write_wav_header(&(wavs[i])))
+		{
+			g_printerr("Track %u: could not finalize WAV header\n", i + 1);
+			ret = 1;
+		}
+	}
+
+cleanup:
+	for (i = 0; i < num_tracks; ++i)
+	{
+		if (wavs[i].file != NULL)
+			fclose(wavs[i].file);
+	}
+
+	g_free(track_errors);
+	g_free(wavs);
+	g_free(tracks);
+	g_free(data);
+
+	return ret;
+}
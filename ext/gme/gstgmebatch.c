@@ -0,0 +1,164 @@
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include "gstgmebatch.h"
+#include "gstgmeloader.h"
+
+
+/* number of stereo frames rendered per gme_play() call */
+#define BATCH_BLOCK_FRAMES 4096
+
+
+typedef struct
+{
+	void const *data;
+	long size;
+	guint const *tracks;
+	guint num_tracks;
+	int sample_rate;
+	gint num_loops;
+	gboolean enable_accuracy;
+	GstGmeBatchOutputFunc output_func;
+	gpointer user_data;
+	gme_err_t *track_errors;
+
+	/* index of the next entry in tracks to render; the workers
+	 * pick their tracks by atomically incrementing this */
+	volatile gint next_track_index;
+	volatile gint num_failed;
+}
+gst_gme_batch_context;
+
+
+static gme_err_t gst_gme_batch_render_track(gst_gme_batch_context *context, gme_t *emu, guint track, gint16 *samples);
+static gpointer gst_gme_batch_thread_func(gpointer data);
+
+
+
+gboolean gst_gme_batch_render(void const *data, long size, guint const *tracks, guint num_tracks, int sample_rate, gint num_loops, gboolean enable_accuracy, guint num_threads, GstGmeBatchOutputFunc output_func, gpointer user_data, gme_err_t *track_errors)
+{
+	gst_gme_batch_context context;
+	GThread **threads;
+	guint i;
+
+	g_return_val_if_fail(data != NULL, FALSE);
+	g_return_val_if_fail(output_func != NULL, FALSE);
+	g_return_val_if_fail((tracks != NULL) || (num_tracks == 0), FALSE);
+
+	if (num_tracks == 0)
+		return TRUE;
+
+	if (num_threads == 0)
+		num_threads = g_get_num_processors();
+	num_threads = MIN(num_threads, num_tracks);
+
+	context.data = data;
+	context.size = size;
+	context.tracks = tracks;
+	context.num_tracks = num_tracks;
+	context.sample_rate = sample_rate;
+	context.num_loops = num_loops;
+	context.enable_accuracy = enable_accuracy;
+	context.output_func = output_func;
+	context.user_data = user_data;
+	context.track_errors = track_errors;
+	context.next_track_index = 0;
+	context.num_failed = 0;
+
+	threads = g_new0(GThread*, num_threads);
+	for (i = 0; i < num_threads; ++i)
+		threads[i] = g_thread_new("gmebatch", gst_gme_batch_thread_func, &context);
+	for (i = 0; i < num_threads; ++i)
+		g_thread_join(threads[i]);
+	g_free(threads);
+
+	return g_atomic_int_get(&(context.num_failed)) == 0;
+}
+
+
+static gme_err_t gst_gme_batch_render_track(gst_gme_batch_context *context, gme_t *emu, guint track, gint16 *samples)
+{
+	gme_err_t err;
+	gme_info_t *track_info;
+
+	err = gme_track_info(emu, &track_info, track);
+	if (err != NULL)
+	{
+		gme_free_info(track_info);
+		return err;
+	}
+
+	err = gme_start_track(emu, track);
+	if (err != NULL)
+	{
+		gme_free_info(track_info);
+		return err;
+	}
+
+	/* same fade-out rules as in gst_gme_dec_set_num_loops() */
+	if ((context->num_loops >= 0) && (track_info->loop_length > 0))
+		gme_set_fade(emu, track_info->intro_length + (track_info->loop_length * context->num_loops), track_info->loop_length / 16);
+	else
+		gme_set_fade(emu, track_info->play_length, 1000);
+
+	gme_free_info(track_info);
+
+	while (!gme_track_ended(emu))
+	{
+		err = gme_play(emu, BATCH_BLOCK_FRAMES * 2, samples);
+		if (err != NULL)
+			return err;
+
+		if (!context->output_func(track, samples, BATCH_BLOCK_FRAMES * 2, context->user_data))
+			return "Rendering aborted by output function";
+	}
+
+	return NULL;
+}
+
+
+static gpointer gst_gme_batch_thread_func(gpointer data)
+{
+	gst_gme_batch_context *context = (gst_gme_batch_context *)data;
+	gme_t *emu = NULL;
+	gme_err_t open_err;
+	gint16 *samples;
+
+	/* Each worker has its own emulator; opening it does not copy the
+	 * data, so all workers share the same media data */
+	open_err = gst_gme_open_mem(context->data, context->size, &emu, context->sample_rate);
+	if (open_err == NULL)
+		gme_enable_accuracy(emu, context->enable_accuracy);
+	samples = g_new(gint16, BATCH_BLOCK_FRAMES * 2);
+
+	while (TRUE)
+	{
+		gme_err_t err;
+		guint index = (guint)g_atomic_int_add(&(context->next_track_index), 1);
+		guint track;
+
+		if (index >= context->num_tracks)
+			break;
+
+		track = context->tracks[index];
+
+		if (open_err != NULL)
+			err = open_err;
+		else if (track >= (guint)gme_track_count(emu))
+			err = "Invalid track";
+		else
+			err = gst_gme_batch_render_track(context, emu, track, samples);
+
+		if (err != NULL)
+			g_atomic_int_inc(&(context->num_failed));
+		if (context->track_errors != NULL)
+			context->track_errors[index] = err;
+	}
+
+	g_free(samples);
+	if (emu != NULL)
+		gme_delete(emu);
+
+	return NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef GSTGMEBATCH_H
+#define GSTGMEBATCH_H
+
+
+#include <glib.h>
+#include <gme/gme.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Called with consecutive blocks of interleaved stereo samples of one
+ * track. Different tracks are rendered by different threads, so this is
+ * called concurrently, but never concurrently for the same track. If it
+ * returns FALSE, rendering of that track stops. */
+typedef gboolean (*GstGmeBatchOutputFunc)(guint track, gint16 const *samples, gsize num_samples, gpointer user_data);
+
+
+/* Renders the given tracks of a music file concurrently, with one emulator
+ * per worker thread. All emulators use the data in place, so it is read
+ * only once, no matter how many tracks are rendered.
+ *
+ * Track lengths are taken from the track information, like gmedec does:
+ * if num_loops is >= 0 and the track has a loop, the track is rendered
+ * until the end of the given number of loops, otherwise until its play
+ * length. Either way, it is faded out at the end.
+ *
+ * If enable_accuracy is TRUE, the emulators use their accurate sound
+ * emulation options, like gmedec's enable-accuracy property does.
+ *
+ * num_threads 0 means one thread per processor. If track_errors is not
+ * NULL, it must have num_tracks entries; it is filled with the error of
+ * each track, or NULL if that track was rendered successfully.
+ *
+ * Returns TRUE if all tracks were rendered successfully. */
+gboolean gst_gme_batch_render(void const *data, long size, guint const *tracks, guint num_tracks, int sample_rate, gint num_loops, gboolean enable_accuracy, guint num_threads, GstGmeBatchOutputFunc output_func, gpointer user_data, gme_err_t *track_errors);
+
+
+G_END_DECLS
+
+
+#endif
@@ -5,8 +5,13 @@
 #include <gst/gst.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 
 #include "gstgmedec.h"
+#include "gstgmeloader.h"
 #include <gme/gme_custom_dprintf.h>
 
 
@@ -20,14 +25,35 @@ enum
 	PROP_ECHO,
 	PROP_STEREO_SEPARATION,
 	PROP_ENABLE_EFFECTS,
-	PROP_ENABLE_SURROUND
+	PROP_ENABLE_SURROUND,
+	PROP_ENABLE_ACCURACY,
+	PROP_CHECKPOINT_INTERVAL,
+	PROP_MAX_CHECKPOINTS
 };
 
 
-#define DEFAULT_ECHO               0.2
-#define DEFAULT_STEREO_SEPARATION  0.2
-#define DEFAULT_ENABLE_EFFECTS     FALSE
-#define DEFAULT_ENABLE_SURROUND    TRUE
+#define DEFAULT_ECHO                 0.2
+#define DEFAULT_STEREO_SEPARATION    0.2
+#define DEFAULT_ENABLE_EFFECTS       FALSE
+#define DEFAULT_ENABLE_SURROUND      TRUE
+#define DEFAULT_ENABLE_ACCURACY      FALSE
+#define DEFAULT_CHECKPOINT_INTERVAL  0
+#define DEFAULT_MAX_CHECKPOINTS      4
+
+/* checkpoint emulators are moved forward in steps of this
+ * length, so that cancelling them does not take long */
+#define CHECKPOINT_STEP_MSECONDS 1000
+
+#ifdef HAVE_ZLIB_H
+/* number of bytes the VGZ typefinder inflates the beginning of;
+ * this must be enough to cover the gzip header, which can contain
+ * the original file name and a comment */
+#define VGZ_TYPEFIND_SIZE 4096
+/* sanity limit for the decompressed size of VGZ data */
+#define VGZ_MAX_INFLATED_SIZE (256 * 1024 * 1024)
+
+static GstStaticCaps vgz_caps = GST_STATIC_CAPS("audio/x-vgm, compressed = (boolean) true");
+#endif
 
 
 
@@ -70,6 +96,8 @@ G_DEFINE_TYPE(GstGmeDec, gst_gme_dec, GST_TYPE_NONSTREAM_AUDIO_DECODER)
 
 
 static void gst_gme_dec_finalize(GObject *object);
+static GstStateChangeReturn gst_gme_dec_change_state(GstElement *element, GstStateChange transition);
+static void gst_gme_dec_unload(GstGmeDec *gme_dec);
 
 static void gst_gme_dec_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void gst_gme_dec_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
@@ -77,13 +105,24 @@ static void gst_gme_dec_get_property(GObject *object, guint prop_id, GValue *val
 static gboolean gst_gme_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position);
 static GstClockTime gst_gme_dec_tell(GstNonstreamAudioDecoder *dec);
 
+static gst_gme_dec_track_info const * gst_gme_dec_get_track_info(GstGmeDec *gme_dec, guint track_nr);
+static void gst_gme_dec_free_track_infos(GstGmeDec *gme_dec);
 static GstTagList* gst_gme_dec_tags_from_track_info(GstGmeDec *gme_dec, guint track_nr);
 static GstClockTime gst_gme_dec_duration_from_track_info(GstGmeDec *gme_dec, guint track_nr);
 
 static gboolean gst_gme_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *source_data, guint initial_subsong, GstNonstreamAudioSubsongMode initial_subsong_mode, GstClockTime *initial_position, GstNonstreamAudioOutputMode *initial_output_mode, gint *initial_num_loops);
 
+#ifdef HAVE_ZLIB_H
+static GstBuffer* gst_gme_dec_inflate_vgz(GstGmeDec *gme_dec, GstBuffer *source_data);
+#endif
+
 static void gst_gme_dec_update_effects(GstGmeDec *gme_dec);
 
+static void gst_gme_dec_start_checkpoints(GstGmeDec *gme_dec);
+static void gst_gme_dec_clear_checkpoints(GstGmeDec *gme_dec);
+static gme_t* gst_gme_dec_take_checkpoint(GstGmeDec *gme_dec, int position, int current_position);
+static void gst_gme_dec_checkpoint_func(gpointer data, gpointer user_data);
+
 static gboolean gst_gme_dec_set_current_subsong(GstNonstreamAudioDecoder *dec, guint subsong, GstClockTime *initial_position);
 static guint gst_gme_dec_get_current_subsong(GstNonstreamAudioDecoder *dec);
 
@@ -101,6 +140,10 @@ static gboolean gst_gme_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer **bu
 static void gst_gme_dec_custom_dprintf(const char * fmt, va_list vl);
 #endif
 
+#ifdef HAVE_ZLIB_H
+static void gst_gme_dec_vgz_typefind(GstTypeFind *tf, gpointer user_data);
+#endif
+
 
 
 void gst_gme_dec_class_init(GstGmeDecClass *klass)
@@ -122,6 +165,8 @@ void gst_gme_dec_class_init(GstGmeDecClass *klass)
 	object_class->set_property = GST_DEBUG_FUNCPTR(gst_gme_dec_set_property);
 	object_class->get_property = GST_DEBUG_FUNCPTR(gst_gme_dec_get_property);
 
+	element_class->change_state = GST_DEBUG_FUNCPTR(gst_gme_dec_change_state);
+
 	dec_class->seek = GST_DEBUG_FUNCPTR(gst_gme_dec_seek);
 	dec_class->tell = GST_DEBUG_FUNCPTR(gst_gme_dec_tell);
 	dec_class->load_from_buffer = GST_DEBUG_FUNCPTR(gst_gme_dec_load_from_buffer);
@@ -181,6 +226,41 @@ void gst_gme_dec_class_init(GstGmeDecClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_ENABLE_ACCURACY,
+		g_param_spec_boolean(
+			"enable-accuracy",
+			"Enable accurate emulation",
+			"Use the most accurate sound emulation options the emulator core offers (takes effect when a file is loaded)",
+			DEFAULT_ENABLE_ACCURACY,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_CHECKPOINT_INTERVAL,
+		g_param_spec_uint(
+			"checkpoint-interval",
+			"Checkpoint interval",
+			"Interval between seek checkpoints, in seconds; at each one (and at the loop start), an additional emulator is kept ready in the background, which makes seeks much faster at the cost of CPU and memory (0 = no checkpoints; takes effect when a track is started)",
+			0, G_MAXINT / 1000,
+			DEFAULT_CHECKPOINT_INTERVAL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+	g_object_class_install_property(
+		object_class,
+		PROP_MAX_CHECKPOINTS,
+		g_param_spec_uint(
+			"max-checkpoints",
+			"Maximum number of checkpoints",
+			"Maximum number of seek checkpoints per track (= maximum number of additional emulators)",
+			1, 64,
+			DEFAULT_MAX_CHECKPOINTS,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
 
 	gst_element_class_set_static_metadata(
 		element_class,
@@ -202,11 +282,25 @@ void gst_gme_dec_init(GstGmeDec *gme_dec)
 	gme_dec->cur_track = 0;
 	gme_dec->num_tracks = 0;
 	gme_dec->num_loops = 0;
+	gme_dec->track_infos = NULL;
+	gme_dec->track_info_valid = NULL;
 
 	gme_dec->echo = DEFAULT_ECHO;
 	gme_dec->stereo_separation = DEFAULT_STEREO_SEPARATION;
 	gme_dec->enable_effects = DEFAULT_ENABLE_EFFECTS;
 	gme_dec->enable_surround = DEFAULT_ENABLE_SURROUND;
+	gme_dec->enable_accuracy = DEFAULT_ENABLE_ACCURACY;
+	gme_dec->accuracy_enabled = DEFAULT_ENABLE_ACCURACY;
+
+	gme_dec->checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+	gme_dec->max_checkpoints = DEFAULT_MAX_CHECKPOINTS;
+	gme_dec->source_data = NULL;
+	gme_dec->sample_rate = 0;
+	g_mutex_init(&(gme_dec->checkpoints_lock));
+	gme_dec->checkpoints = NULL;
+	gme_dec->num_checkpoints = 0;
+	gme_dec->checkpoint_pool = NULL;
+	gme_dec->checkpoints_cancelled = 0;
 }
 
 
@@ -217,8 +311,83 @@ static void gst_gme_dec_finalize(GObject *object)
 	g_return_if_fail(GST_IS_GME_DEC(object));
 	gme_dec = GST_GME_DEC(object);
 
+	gst_gme_dec_unload(gme_dec);
+	g_mutex_clear(&(gme_dec->checkpoints_lock));
+
+	G_OBJECT_CLASS(gst_gme_dec_parent_class)->finalize(object);
+}
+
+
+static GstStateChangeReturn gst_gme_dec_change_state(GstElement *element, GstStateChange transition)
+{
+	GstNonstreamAudioDecoder *dec = GST_NONSTREAM_AUDIO_DECODER(element);
+	GstGmeDec *gme_dec = GST_GME_DEC(element);
+	GstStateChangeReturn ret;
+
+	ret = GST_ELEMENT_CLASS(gst_gme_dec_parent_class)->change_state(element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+		return ret;
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_READY_TO_PAUSED:
+			/* Set up the checkpoints again if they were cleared by an
+			 * earlier PAUSED->READY state change. If nothing is loaded
+			 * yet, emu is NULL, and the checkpoints are set up by
+			 * load_from_buffer instead. */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			if ((gme_dec->emu != NULL) && (gme_dec->checkpoint_pool == NULL) && !(dec->metadata_only))
+				gst_gme_dec_start_checkpoints(gme_dec);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+			/* The checkpoint emulators would otherwise keep running in the
+			 * background until the element is destroyed */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gst_gme_dec_clear_checkpoints(gme_dec);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		case GST_STATE_CHANGE_READY_TO_NULL:
+			/* The base class reset its state, so the next READY->PAUSED
+			 * state change loads new media */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gst_gme_dec_unload(gme_dec);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		default:
+			break;
+	}
+
+	return ret;
+}
+
+
+static void gst_gme_dec_unload(GstGmeDec *gme_dec)
+{
+	/* The checkpoint threads access the decoder, so they must be gone first */
+	gst_gme_dec_clear_checkpoints(gme_dec);
+
 	if (gme_dec->emu != NULL)
+	{
 		gme_delete(gme_dec->emu);
+		gme_dec->emu = NULL;
+	}
+
+	gst_gme_dec_free_track_infos(gme_dec);
+	gme_dec->num_tracks = 0;
+	gme_dec->cur_track = 0;
+
+	/* the emulators might have used the data in place,
+	 * so it can only be released after they are gone */
+	if (gme_dec->source_data != NULL)
+	{
+		gst_buffer_unmap(gme_dec->source_data, &(gme_dec->source_map));
+		gst_buffer_unref(gme_dec->source_data);
+		gme_dec->source_data = NULL;
+	}
 }
 
 
@@ -263,6 +432,27 @@ static void gst_gme_dec_set_property(GObject *object, guint prop_id, const GValu
 
 			break;
 		}
+		case PROP_ENABLE_ACCURACY:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gme_dec->enable_accuracy = g_value_get_boolean(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+		}
+		case PROP_CHECKPOINT_INTERVAL:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gme_dec->checkpoint_interval = g_value_get_uint(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+		}
+		case PROP_MAX_CHECKPOINTS:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gme_dec->max_checkpoints = g_value_get_uint(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+		}
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -305,6 +495,27 @@ static void gst_gme_dec_get_property(GObject *object, guint prop_id, GValue *val
 
 			break;
 		}
+		case PROP_ENABLE_ACCURACY:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
+			g_value_set_boolean(value, gme_dec->enable_accuracy);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			break;
+		}
+		case PROP_CHECKPOINT_INTERVAL:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
+			g_value_set_uint(value, gme_dec->checkpoint_interval);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			break;
+		}
+		case PROP_MAX_CHECKPOINTS:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
+			g_value_set_uint(value, gme_dec->max_checkpoints);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			break;
+		}
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -315,10 +526,29 @@ static void gst_gme_dec_get_property(GObject *object, guint prop_id, GValue *val
 static gboolean gst_gme_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position)
 {
 	gme_err_t err;
+	gme_t *checkpoint_emu;
+	int position;
 	GstGmeDec *gme_dec = GST_GME_DEC(dec);
 	g_return_val_if_fail(gme_dec->emu != NULL, FALSE);
 
-	err = gme_seek(gme_dec->emu, *new_position / GST_MSECOND);
+	position = *new_position / GST_MSECOND;
+
+	/* GME can only seek forwards from the current position; seeking
+	 * backwards restarts the track, and emulates everything up to the
+	 * new position. If there is a checkpoint emulator which is closer
+	 * to the new position, continue with that one instead. */
+	checkpoint_emu = gst_gme_dec_take_checkpoint(gme_dec, position, gme_tell(gme_dec->emu));
+	if (checkpoint_emu != NULL)
+	{
+		gme_delete(gme_dec->emu);
+		gme_dec->emu = checkpoint_emu;
+
+		/* effects and the fade-out are only set up for the playing emulator */
+		gst_gme_dec_update_effects(gme_dec);
+		gst_gme_dec_set_num_loops(dec, gme_dec->num_loops);
+	}
+
+	err = gme_seek(gme_dec->emu, position);
 	if (G_UNLIKELY(err != NULL))
 	{
 		GST_ERROR_OBJECT(dec, "error while seeking: %s", err);
@@ -344,15 +574,21 @@ static GstClockTime gst_gme_dec_tell(GstNonstreamAudioDecoder *dec)
 }
 
 
-static GstTagList* gst_gme_dec_tags_from_track_info(GstGmeDec *gme_dec, guint track_nr)
+static gst_gme_dec_track_info const * gst_gme_dec_get_track_info(GstGmeDec *gme_dec, guint track_nr)
 {
-	GstTagList *tags;
+	/* must be called with lock */
+
+	gst_gme_dec_track_info *info;
 	gme_err_t err;
 	gme_info_t *track_info;
+	GstTagList *tags;
 
-	g_return_val_if_fail(gme_dec->emu != NULL, FALSE);
+	g_return_val_if_fail(gme_dec->emu != NULL, NULL);
+	g_return_val_if_fail(track_nr < gme_dec->num_tracks, NULL);
 
-	tags = NULL;
+	info = &(gme_dec->track_infos[track_nr]);
+	if (gme_dec->track_info_valid[track_nr])
+		return info;
 
 	err = gme_track_info(gme_dec->emu, &track_info, track_nr);
 	if (G_UNLIKELY(err != NULL))
@@ -362,6 +598,21 @@ static GstTagList* gst_gme_dec_tags_from_track_info(GstGmeDec *gme_dec, guint tr
 		return NULL;
 	}
 
+	GST_DEBUG_OBJECT(
+		gme_dec,
+		"track %u info length stats:  length: %d  intro length: %d  loop length: %d  play length: %d",
+		track_nr,
+		track_info->length,
+		track_info->intro_length,
+		track_info->loop_length,
+		track_info->play_length
+	);
+
+	info->length = track_info->length;
+	info->intro_length = track_info->intro_length;
+	info->loop_length = track_info->loop_length;
+	info->play_length = track_info->play_length;
+
 	tags = gst_tag_list_new_empty();
 
 #define GME_ADD_TO_TAGS(INFO_FIELD, TAG_TYPE) \
@@ -378,61 +629,78 @@ static GstTagList* gst_gme_dec_tags_from_track_info(GstGmeDec *gme_dec, guint tr
 
 #undef GME_ADD_TO_TAGS
 
+	info->tags = tags;
+
 	gme_free_info(track_info);
 
-	return tags;
+	gme_dec->track_info_valid[track_nr] = TRUE;
+
+	return info;
 }
 
 
-static GstClockTime gst_gme_dec_duration_from_track_info(GstGmeDec *gme_dec, guint track_nr)
+static void gst_gme_dec_free_track_infos(GstGmeDec *gme_dec)
 {
-	gme_err_t err;
-	gme_info_t *track_info;
-	GstClockTime duration;
+	guint i;
 
-	err = gme_track_info(gme_dec->emu, &track_info, track_nr);
-	if (G_UNLIKELY(err != NULL))
-	{
-		GST_ERROR_OBJECT(gme_dec, "error while trying to get track information: %s", err);
-		duration = GST_CLOCK_TIME_NONE;
-	}
-	else
+	if (gme_dec->track_infos == NULL)
+		return;
+
+	for (i = 0; i < gme_dec->num_tracks; ++i)
 	{
-		GST_DEBUG_OBJECT(
-			gme_dec,
-			"track info length stats:  length: %d  intro length: %d  loop length: %d  play length: %d",
-			track_info->length,
-			track_info->intro_length,
-			track_info->loop_length,
-			track_info->play_length
-		);
-
-		if (gme_dec->num_loops < 0) {
-			duration = (GstClockTime)(track_info->play_length) * GST_MSECOND;
-		} else {
-			duration = (GstClockTime)(track_info->intro_length + track_info->loop_length * gme_dec->num_loops) * GST_MSECOND;
-		}
+		if (gme_dec->track_info_valid[i])
+			gst_tag_list_unref(gme_dec->track_infos[i].tags);
 	}
 
-	gme_free_info(track_info);
+	g_free(gme_dec->track_infos);
+	g_free(gme_dec->track_info_valid);
+	gme_dec->track_infos = NULL;
+	gme_dec->track_info_valid = NULL;
+}
 
-	return duration;
+
+static GstTagList* gst_gme_dec_tags_from_track_info(GstGmeDec *gme_dec, guint track_nr)
+{
+	gst_gme_dec_track_info const *info = gst_gme_dec_get_track_info(gme_dec, track_nr);
+
+	/* the caller takes ownership of the list and may modify it,
+	 * so the cached one must not be handed out */
+	return (info != NULL) ? gst_tag_list_copy(info->tags) : NULL;
+}
+
+
+static GstClockTime gst_gme_dec_duration_from_track_info(GstGmeDec *gme_dec, guint track_nr)
+{
+	gst_gme_dec_track_info const *info = gst_gme_dec_get_track_info(gme_dec, track_nr);
+
+	if (info == NULL)
+		return GST_CLOCK_TIME_NONE;
+
+	if (gme_dec->num_loops < 0) {
+		return (GstClockTime)(info->play_length) * GST_MSECOND;
+	} else {
+		return (GstClockTime)(info->intro_length + info->loop_length * gme_dec->num_loops) * GST_MSECOND;
+	}
 }
 
 
 static gboolean gst_gme_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *source_data, guint initial_subsong, G_GNUC_UNUSED GstNonstreamAudioSubsongMode initial_subsong_mode, GstClockTime *initial_position, GstNonstreamAudioOutputMode *initial_output_mode, gint *initial_num_loops)
 {
-	GstMapInfo map;
 	gme_err_t err;
 	GstGmeDec *gme_dec;
 	gint sample_rate;
 
 	gme_dec = GST_GME_DEC(dec);
 
+	/* after a READY->NULL->READY cycle, the base class loads again;
+	 * get rid of anything left over from an earlier load */
+	gst_gme_dec_unload(gme_dec);
+
 	sample_rate = 48000;
 	gst_nonstream_audio_decoder_get_downstream_info(dec, NULL, &sample_rate, NULL);
 
-	/* Set output format */
+	/* Set output format; gme_play() only renders interleaved
+	 * 16-bit stereo, so there is no float output path */
 	if (!gst_nonstream_audio_decoder_set_output_format_simple(
 		dec,
 		sample_rate,
@@ -441,9 +709,31 @@ static gboolean gst_gme_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstB
 	))
 		return FALSE;
 
-	gst_buffer_map(source_data, &map, GST_MAP_READ);
-	err = gme_open_data(map.data, map.size, &(gme_dec->emu), sample_rate);
-	gst_buffer_unmap(source_data, &map);
+#ifdef HAVE_ZLIB_H
+	/* VGZ files are gzip-compressed VGM files (see gst_gme_dec_vgz_typefind) */
+	if ((gst_buffer_get_size(source_data) >= 2) && (gst_buffer_memcmp(source_data, 0, "\x1f\x8b", 2) == 0))
+	{
+		gme_dec->source_data = gst_gme_dec_inflate_vgz(gme_dec, source_data);
+		if (gme_dec->source_data == NULL)
+			return FALSE;
+	}
+	else
+#endif
+		gme_dec->source_data = gst_buffer_ref(source_data);
+
+	/* Keep the data mapped and let GME use it in place instead of copying
+	 * it; checkpoint emulators are created out of the same mapping */
+	if (!gst_buffer_map(gme_dec->source_data, &(gme_dec->source_map), GST_MAP_READ))
+	{
+		GST_ERROR_OBJECT(dec, "could not map source data");
+		gst_buffer_unref(gme_dec->source_data);
+		gme_dec->source_data = NULL;
+		return FALSE;
+	}
+	gme_dec->sample_rate = sample_rate;
+	gme_dec->accuracy_enabled = gme_dec->enable_accuracy;
+
+	err = gst_gme_open_mem(gme_dec->source_map.data, gme_dec->source_map.size, &(gme_dec->emu), sample_rate);
 
 	if (G_UNLIKELY(err != NULL))
 	{
@@ -451,7 +741,12 @@ static gboolean gst_gme_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstB
 		return FALSE;
 	}
 
+	GST_DEBUG_OBJECT(dec, "accurate emulation %s", gme_dec->accuracy_enabled ? "enabled" : "disabled");
+	gme_enable_accuracy(gme_dec->emu, gme_dec->accuracy_enabled);
+
 	gme_dec->num_tracks = gme_track_count(gme_dec->emu);
+	gme_dec->track_infos = g_new0(gst_gme_dec_track_info, gme_dec->num_tracks);
+	gme_dec->track_info_valid = g_new0(gboolean, gme_dec->num_tracks);
 	if (G_UNLIKELY(initial_subsong >= gme_dec->num_tracks))
 	{
 		GST_WARNING_OBJECT(gme_dec, "initial subsong %u out of bounds (there are %u subsongs) - setting it to 0", initial_subsong, gme_dec->num_tracks);
@@ -467,16 +762,96 @@ static gboolean gst_gme_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstB
 		return FALSE;
 	}
 
+	gme_dec->cur_track = initial_subsong;
+
 	*initial_position = 0;
 	*initial_output_mode = GST_NONSTREM_AUDIO_OUTPUT_MODE_STEADY;
 
 	gst_gme_dec_update_effects(gme_dec);
 	gst_gme_dec_set_num_loops(dec, *initial_num_loops);
 
+	if (!(dec->metadata_only))
+		gst_gme_dec_start_checkpoints(gme_dec);
+
 	return TRUE;
 }
 
 
+#ifdef HAVE_ZLIB_H
+
+static GstBuffer* gst_gme_dec_inflate_vgz(GstGmeDec *gme_dec, GstBuffer *source_data)
+{
+	GstMapInfo in_map, out_map;
+	GstBuffer *inflated;
+	z_stream strm;
+	guint8 const *isize_bytes;
+	gsize inflated_size;
+	int ret;
+
+	gst_buffer_map(source_data, &in_map, GST_MAP_READ);
+
+	/* The last 4 bytes of gzip data (ISIZE) contain the size of the
+	 * uncompressed data (modulo 2^32), so the output buffer can be
+	 * allocated upfront, and the data can be inflated in one pass */
+	if (in_map.size < 18)
+	{
+		GST_ERROR_OBJECT(gme_dec, "VGZ data too small");
+		gst_buffer_unmap(source_data, &in_map);
+		return NULL;
+	}
+
+	isize_bytes = in_map.data + in_map.size - 4;
+	inflated_size = GST_READ_UINT32_LE(isize_bytes);
+	if ((inflated_size == 0) || (inflated_size > VGZ_MAX_INFLATED_SIZE))
+	{
+		GST_ERROR_OBJECT(gme_dec, "invalid uncompressed VGZ size %" G_GSIZE_FORMAT, inflated_size);
+		gst_buffer_unmap(source_data, &in_map);
+		return NULL;
+	}
+
+	inflated = gst_buffer_new_allocate(NULL, inflated_size, NULL);
+	if (inflated == NULL)
+	{
+		GST_ERROR_OBJECT(gme_dec, "could not allocate %" G_GSIZE_FORMAT " bytes for uncompressed VGZ data", inflated_size);
+		gst_buffer_unmap(source_data, &in_map);
+		return NULL;
+	}
+	gst_buffer_map(inflated, &out_map, GST_MAP_WRITE);
+
+	memset(&strm, 0, sizeof(strm));
+	/* 16 + MAX_WBITS -> expect a gzip header and trailer */
+	ret = inflateInit2(&strm, 16 + MAX_WBITS);
+	if (ret == Z_OK)
+	{
+		strm.next_in = (Bytef *)(in_map.data);
+		strm.avail_in = in_map.size;
+		strm.next_out = out_map.data;
+		strm.avail_out = out_map.size;
+
+		ret = inflate(&strm, Z_FINISH);
+		inflateEnd(&strm);
+	}
+
+	gst_buffer_unmap(inflated, &out_map);
+	gst_buffer_unmap(source_data, &in_map);
+
+	/* anything else than a single gzip member whose size
+	 * exactly matches ISIZE is considered to be broken */
+	if ((ret != Z_STREAM_END) || (strm.total_out != inflated_size))
+	{
+		GST_ERROR_OBJECT(gme_dec, "could not inflate VGZ data: %s", (strm.msg != NULL) ? strm.msg : "size mismatch");
+		gst_buffer_unref(inflated);
+		return NULL;
+	}
+
+	GST_DEBUG_OBJECT(gme_dec, "inflated %" G_GSIZE_FORMAT " bytes of VGZ data to %" G_GSIZE_FORMAT " bytes", in_map.size, inflated_size);
+
+	return inflated;
+}
+
+#endif
+
+
 static void gst_gme_dec_update_effects(GstGmeDec *gme_dec)
 {
 	gme_effects_t effects;
@@ -493,6 +868,189 @@ static void gst_gme_dec_update_effects(GstGmeDec *gme_dec)
 }
 
 
+static void gst_gme_dec_start_checkpoints(GstGmeDec *gme_dec)
+{
+	/* must be called with lock */
+
+	gst_gme_dec_track_info const *track_info;
+	GArray *positions;
+	int position;
+	guint i;
+
+	gst_gme_dec_clear_checkpoints(gme_dec);
+
+	if (gme_dec->checkpoint_interval == 0)
+		return;
+
+	track_info = gst_gme_dec_get_track_info(gme_dec, gme_dec->cur_track);
+	if (G_UNLIKELY(track_info == NULL))
+	{
+		GST_WARNING_OBJECT(gme_dec, "could not get track information - not setting up checkpoints");
+		return;
+	}
+
+	positions = g_array_new(FALSE, FALSE, sizeof(int));
+
+	/* The loop start is a common seek target */
+	if ((track_info->intro_length > 0) && (track_info->loop_length > 0))
+		g_array_append_val(positions, track_info->intro_length);
+
+	for (position = gme_dec->checkpoint_interval * 1000; (position < track_info->play_length) && (positions->len < gme_dec->max_checkpoints); position += gme_dec->checkpoint_interval * 1000)
+		g_array_append_val(positions, position);
+
+	if (positions->len == 0)
+	{
+		g_array_free(positions, TRUE);
+		return;
+	}
+
+	gme_dec->num_checkpoints = positions->len;
+	gme_dec->checkpoints = g_new0(gst_gme_dec_checkpoint, gme_dec->num_checkpoints);
+	gme_dec->checkpoint_pool = g_thread_pool_new(gst_gme_dec_checkpoint_func, gme_dec, g_get_num_processors(), FALSE, NULL);
+
+	for (i = 0; i < gme_dec->num_checkpoints; ++i)
+	{
+		gst_gme_dec_checkpoint *checkpoint = &(gme_dec->checkpoints[i]);
+		checkpoint->track = gme_dec->cur_track;
+		checkpoint->position = g_array_index(positions, int, i);
+		checkpoint->emu = NULL;
+		g_thread_pool_push(gme_dec->checkpoint_pool, checkpoint, NULL);
+	}
+
+	GST_DEBUG_OBJECT(gme_dec, "set up %u checkpoint(s) for track %u", gme_dec->num_checkpoints, gme_dec->cur_track);
+
+	g_array_free(positions, TRUE);
+}
+
+
+static void gst_gme_dec_clear_checkpoints(GstGmeDec *gme_dec)
+{
+	guint i;
+
+	if (gme_dec->checkpoint_pool != NULL)
+	{
+		/* drop checkpoints that were not started yet, and
+		 * wait for the ones that are being emulated to stop */
+		g_atomic_int_set(&(gme_dec->checkpoints_cancelled), 1);
+		g_thread_pool_free(gme_dec->checkpoint_pool, TRUE, TRUE);
+		gme_dec->checkpoint_pool = NULL;
+		g_atomic_int_set(&(gme_dec->checkpoints_cancelled), 0);
+	}
+
+	for (i = 0; i < gme_dec->num_checkpoints; ++i)
+	{
+		if (gme_dec->checkpoints[i].emu != NULL)
+			gme_delete(gme_dec->checkpoints[i].emu);
+	}
+
+	g_free(gme_dec->checkpoints);
+	gme_dec->checkpoints = NULL;
+	gme_dec->num_checkpoints = 0;
+}
+
+
+static gme_t* gst_gme_dec_take_checkpoint(GstGmeDec *gme_dec, int position, int current_position)
+{
+	/* Returns the emulator of the ready checkpoint that is closest to (and
+	 * not after) position, if it is closer than the emulator that is
+	 * currently playing; the caller takes ownership of it */
+
+	gst_gme_dec_checkpoint *best = NULL;
+	int best_position;
+	gme_t *emu = NULL;
+	guint i;
+
+	/* seeking backwards restarts the track */
+	best_position = (position >= current_position) ? current_position : 0;
+
+	g_mutex_lock(&(gme_dec->checkpoints_lock));
+
+	for (i = 0; i < gme_dec->num_checkpoints; ++i)
+	{
+		gst_gme_dec_checkpoint *checkpoint = &(gme_dec->checkpoints[i]);
+		if ((checkpoint->emu != NULL) && (checkpoint->position <= position) && (checkpoint->position > best_position))
+		{
+			best = checkpoint;
+			best_position = checkpoint->position;
+		}
+	}
+
+	if (best != NULL)
+	{
+		emu = best->emu;
+		best->emu = NULL;
+	}
+
+	g_mutex_unlock(&(gme_dec->checkpoints_lock));
+
+	if (best != NULL)
+	{
+		GST_DEBUG_OBJECT(gme_dec, "using checkpoint at %d ms for seeking to %d ms", best->position, position);
+		/* park a new emulator at this checkpoint */
+		g_thread_pool_push(gme_dec->checkpoint_pool, best, NULL);
+	}
+
+	return emu;
+}
+
+
+static void gst_gme_dec_checkpoint_func(gpointer data, gpointer user_data)
+{
+	gst_gme_dec_checkpoint *checkpoint = (gst_gme_dec_checkpoint *)data;
+	GstGmeDec *gme_dec = GST_GME_DEC(user_data);
+	gme_err_t err;
+	gme_t *emu = NULL;
+	int position;
+
+	if (g_atomic_int_get(&(gme_dec->checkpoints_cancelled)))
+		return;
+
+	err = gst_gme_open_mem(gme_dec->source_map.data, gme_dec->source_map.size, &emu, gme_dec->sample_rate);
+
+	if (G_UNLIKELY(err != NULL))
+	{
+		GST_WARNING_OBJECT(gme_dec, "could not create checkpoint emulator: %s", err);
+		return;
+	}
+
+	/* the checkpoint emulator replaces the playing one, so it must sound the same */
+	gme_enable_accuracy(emu, gme_dec->accuracy_enabled);
+
+	err = gme_start_track(emu, checkpoint->track);
+	if (G_UNLIKELY(err != NULL))
+	{
+		GST_WARNING_OBJECT(gme_dec, "could not start track in checkpoint emulator: %s", err);
+		gme_delete(emu);
+		return;
+	}
+
+	/* emulate up to the checkpoint in steps, checking for cancellation in between */
+	for (position = 0; position < checkpoint->position;)
+	{
+		if (g_atomic_int_get(&(gme_dec->checkpoints_cancelled)) || gme_track_ended(emu))
+		{
+			gme_delete(emu);
+			return;
+		}
+
+		position = MIN(position + CHECKPOINT_STEP_MSECONDS, checkpoint->position);
+		err = gme_seek(emu, position);
+		if (G_UNLIKELY(err != NULL))
+		{
+			GST_WARNING_OBJECT(gme_dec, "could not move checkpoint emulator to %d ms: %s", position, err);
+			gme_delete(emu);
+			return;
+		}
+	}
+
+	GST_LOG_OBJECT(gme_dec, "checkpoint at %d ms is ready", checkpoint->position);
+
+	g_mutex_lock(&(gme_dec->checkpoints_lock));
+	checkpoint->emu = emu;
+	g_mutex_unlock(&(gme_dec->checkpoints_lock));
+}
+
+
 static gboolean gst_gme_dec_set_current_subsong(GstNonstreamAudioDecoder *dec, guint subsong, GstClockTime *initial_position)
 {
 	gme_err_t err;
@@ -509,6 +1067,9 @@ static gboolean gst_gme_dec_set_current_subsong(GstNonstreamAudioDecoder *dec, g
 	gme_dec->cur_track = subsong;
 	*initial_position = 0;
 
+	/* the checkpoints of the previous track are of no use anymore */
+	gst_gme_dec_start_checkpoints(gme_dec);
+
 	return TRUE;
 }
 
@@ -553,8 +1114,9 @@ static gboolean gst_gme_dec_set_num_loops(GstNonstreamAudioDecoder *dec, gint nu
 	if (G_UNLIKELY(gme_dec->emu == NULL))
 		return FALSE;
 
-	gme_info_t* trackinfo = NULL;
-	gme_track_info(gme_dec->emu, &trackinfo, gme_dec->cur_track);
+	gst_gme_dec_track_info const *trackinfo = gst_gme_dec_get_track_info(gme_dec, gme_dec->cur_track);
+	if (G_UNLIKELY(trackinfo == NULL))
+		return FALSE;
 
 	const gint32 DEFAULT_TRACK_LENGTH = 150000;
 
@@ -570,8 +1132,6 @@ static gboolean gst_gme_dec_set_num_loops(GstNonstreamAudioDecoder *dec, gint nu
 		gme_set_fade(gme_dec->emu, trackinfo->play_length, 1000);
 	}
 
-	gme_free_info(trackinfo);
-
 	return TRUE;
 }
 
@@ -635,9 +1195,56 @@ static void gst_gme_dec_custom_dprintf( const char * fmt, va_list vl )
 
 
 
+#ifdef HAVE_ZLIB_H
+
+static void gst_gme_dec_vgz_typefind(GstTypeFind *tf, G_GNUC_UNUSED gpointer user_data)
+{
+	guint8 const *data;
+	guint64 length;
+	guint size;
+	guint8 header[4];
+	z_stream strm;
+	int ret;
+
+	/* Only gzip data which contains VGM data is recognized here; other
+	 * gzip data is left to the generic gzip typefinder (and to gzipdec),
+	 * which is why gmedec does not accept application/x-gzip directly */
+
+	size = VGZ_TYPEFIND_SIZE;
+	length = gst_type_find_get_length(tf);
+	if ((length > 0) && (length < size))
+		size = length;
+
+	data = gst_type_find_peek(tf, 0, size);
+	if ((data == NULL) || (size < 18) || (data[0] != 0x1f) || (data[1] != 0x8b))
+		return;
+
+	/* inflate just enough to see the VGM magic */
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK)
+		return;
+
+	strm.next_in = (Bytef *)data;
+	strm.avail_in = size;
+	strm.next_out = header;
+	strm.avail_out = sizeof(header);
+	ret = inflate(&strm, Z_SYNC_FLUSH);
+	inflateEnd(&strm);
+
+	if (((ret == Z_OK) || (ret == Z_STREAM_END)) && (strm.avail_out == 0) && (memcmp(header, "Vgm ", 4) == 0))
+		gst_type_find_suggest(tf, GST_TYPE_FIND_MAXIMUM, gst_static_caps_get(&vgz_caps));
+}
+
+#endif
+
+
+
 static gboolean plugin_init(GstPlugin *plugin)
 {
 	if (!gst_element_register(plugin, "gmedec", GST_RANK_PRIMARY + 1, gst_gme_dec_get_type())) return FALSE;
+#ifdef HAVE_ZLIB_H
+	if (!gst_type_find_register(plugin, "gme_vgz", GST_RANK_PRIMARY, gst_gme_dec_vgz_typefind, "vgz", gst_static_caps_get(&vgz_caps), NULL, NULL)) return FALSE;
+#endif
 	return TRUE;
 }
 
@@ -21,16 +21,66 @@ typedef struct _GstGmeDecClass GstGmeDecClass;
 #define GST_IS_GME_DEC_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_GME_DEC))
 
 
+typedef struct
+{
+	/* lengths in milliseconds, as reported by gme_track_info() */
+	int length, intro_length, loop_length, play_length;
+	GstTagList *tags;
+}
+gst_gme_dec_track_info;
+
+
+typedef struct
+{
+	guint track;
+	int position; /* in milliseconds */
+	/* emulator that is parked at the position; NULL
+	 * while it is still being emulated there */
+	gme_t *emu;
+}
+gst_gme_dec_checkpoint;
+
+
 struct _GstGmeDec
 {
 	GstNonstreamAudioDecoder parent;
 
 	gme_t *emu;
 	guint num_tracks, cur_track;
+
+	/* gme_track_info() allocates and parses the information each time
+	 * it is called, so the results are kept here; the entries are filled
+	 * on first access (track_info_valid tells which ones are filled) */
+	gst_gme_dec_track_info *track_infos;
+	gboolean *track_info_valid;
+
+	/* The emulators use the media data in place (see gst_gme_open_mem()),
+	 * so source_data stays mapped for as long as any emulator exists. */
+	GstBuffer *source_data;
+	GstMapInfo source_map;
 	guint num_loops;
 
 	gdouble echo, stereo_separation;
 	gboolean enable_effects, enable_surround;
+	/* enable_accuracy is the property value; accuracy_enabled is
+	 * the setting that was in effect when the file was loaded */
+	gboolean enable_accuracy, accuracy_enabled;
+
+	/* Seek checkpoints are additional emulators, which background threads
+	 * park at certain positions of the current track (every
+	 * checkpoint_interval seconds, and at the loop start). Most GME cores
+	 * cannot save their state, and seeking backwards means emulating
+	 * everything from the start of the track, so seeks take over the
+	 * closest parked emulator instead. The checkpoint array is protected
+	 * by checkpoints_lock. If both this lock and the decoder mutex are
+	 * taken, the decoder mutex must be taken first. */
+	guint checkpoint_interval, max_checkpoints;
+	gint sample_rate;
+	GMutex checkpoints_lock;
+	gst_gme_dec_checkpoint *checkpoints;
+	guint num_checkpoints;
+	GThreadPool *checkpoint_pool;
+	volatile gint checkpoints_cancelled;
 };
 
 
@@ -0,0 +1,39 @@
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include "gstgmeloader.h"
+#include "Music_Emu.h"
+
+
+gme_err_t gst_gme_open_mem(void const *data, long size, gme_t **out, int sample_rate)
+{
+	gme_type_t file_type;
+	Music_Emu *emu;
+	gme_err_t err;
+
+	*out = NULL;
+
+	if (size < 4)
+		return gme_wrong_file_type;
+
+	file_type = gme_identify_extension(gme_identify_header(data));
+	if (file_type == NULL)
+		return gme_wrong_file_type;
+
+	emu = gme_new_emu(file_type, sample_rate);
+	if (emu == NULL)
+		return "Out of memory";
+
+	/* gme_open_data() goes through gme_load_data(), which reads the data
+	 * into an emulator-owned copy; load_mem() uses it in place instead */
+	err = emu->load_mem(data, size);
+	if (err != NULL)
+	{
+		gme_delete(emu);
+		return err;
+	}
+
+	*out = emu;
+	return NULL;
+}
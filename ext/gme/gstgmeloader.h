@@ -0,0 +1,22 @@
+#ifndef GSTGMELOADER_H
+#define GSTGMELOADER_H
+
+
+#include <glib.h>
+#include <gme/gme.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Like gme_open_data(), except that the data is not copied. Depending on
+ * the emulator type, the emulator may keep pointers to the data, so the
+ * data must stay valid until the emulator is deleted. This makes it
+ * possible for several emulators to share the same data. */
+gme_err_t gst_gme_open_mem(void const *data, long size, gme_t **out, int sample_rate);
+
+
+G_END_DECLS
+
+
+#endif
@@ -54,7 +54,8 @@ enum
 	PROP_STEREO_SEPARATION,
 	PROP_FILTER_LENGTH,
 	PROP_VOLUME_RAMPING,
-	PROP_OUTPUT_BUFFER_SIZE
+	PROP_OUTPUT_BUFFER_SIZE,
+	PROP_TOC_ROWS
 };
 
 
@@ -63,10 +64,23 @@ enum
 #define DEFAULT_FILTER_LENGTH 0
 #define DEFAULT_VOLUME_RAMPING -1
 #define DEFAULT_OUTPUT_BUFFER_SIZE 1024
+#define DEFAULT_TOC_ROWS FALSE
 
 #define DEFAULT_SAMPLE_FORMAT GST_AUDIO_FORMAT_F32
 #define DEFAULT_SAMPLE_RATE 48000
 #define DEFAULT_NUM_CHANNELS 2
+#define DEFAULT_LAYOUT GST_AUDIO_LAYOUT_INTERLEAVED
+
+/* highest tempo factor accepted by OpenMPT's interactive interface;
+ * rates beyond this are left to downstream */
+#define MAX_TEMPO_FACTOR 4.0
+
+/* non-interleaved output requires GstAudioMeta, which was introduced in 1.16 */
+#if GST_CHECK_VERSION(1, 16, 0)
+#define LAYOUT_CAPS_STR "layout = (string) { interleaved, non-interleaved }, "
+#else
+#define LAYOUT_CAPS_STR "layout = (string) interleaved, "
+#endif
 
 
 
@@ -87,7 +101,7 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
 	GST_STATIC_CAPS(
 		"audio/x-raw, "
 		"format = (string) { " GST_AUDIO_NE(S16) ", " GST_AUDIO_NE(F32) " }, "
-		"layout = (string) interleaved, "
+		LAYOUT_CAPS_STR
 		"rate = (int) [ 1, 192000 ], "
 		"channels = (int) { 1, 2, 4 } "
 	)
@@ -100,12 +114,19 @@ G_DEFINE_TYPE(GstOpenMptDec, gst_openmpt_dec, GST_TYPE_NONSTREAM_AUDIO_DECODER)
 
 
 static void gst_openmpt_dec_finalize(GObject *object);
+static GstStateChangeReturn gst_openmpt_dec_change_state(GstElement *element, GstStateChange transition);
 
 static void gst_openmpt_dec_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void gst_openmpt_dec_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 
 static gboolean gst_openmpt_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position);
 static GstClockTime gst_openmpt_dec_tell(GstNonstreamAudioDecoder *dec);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static gboolean gst_openmpt_dec_find_seek_points(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime *point_before, GstClockTime *point_after);
+#ifdef HAVE_LIBOPENMPT_EXT
+static gdouble gst_openmpt_dec_set_playback_rate(GstNonstreamAudioDecoder *dec, gdouble rate);
+#endif
+#endif
 
 static void gst_openmpt_dec_log_func(char const *message, void *user);
 static void gst_openmpt_dec_add_metadata_to_tag_list(GstOpenMptDec *openmpt_dec, GstTagList *tags, char const *key, gchar const *tag);
@@ -119,6 +140,9 @@ static guint gst_openmpt_dec_get_current_subsong(GstNonstreamAudioDecoder *dec);
 static guint gst_openmpt_dec_get_num_subsongs(GstNonstreamAudioDecoder *dec);
 static GstClockTime gst_openmpt_dec_get_subsong_duration(GstNonstreamAudioDecoder *dec, guint subsong);
 static GstTagList* gst_openmpt_dec_get_subsong_tags(GstNonstreamAudioDecoder *dec, guint subsong);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static void gst_openmpt_dec_fill_toc_entry(GstNonstreamAudioDecoder *dec, guint subsong, GstTocEntry *entry);
+#endif
 static gboolean gst_openmpt_dec_set_subsong_mode(GstNonstreamAudioDecoder *dec, GstNonstreamAudioSubsongMode mode, GstClockTime *initial_position);
 
 static gboolean gst_openmpt_dec_set_num_loops(GstNonstreamAudioDecoder *dec, gint num_loops);
@@ -129,6 +153,16 @@ static gboolean gst_openmpt_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer
 
 static gboolean gst_openmpt_dec_select_subsong(GstOpenMptDec *openmpt_dec, GstNonstreamAudioSubsongMode subsong_mode, gint openmpt_subsong);
 
+static void gst_openmpt_dec_unload_module(GstOpenMptDec *openmpt_dec);
+
+static void gst_openmpt_dec_start_info_threads(GstOpenMptDec *openmpt_dec);
+static void gst_openmpt_dec_stop_info_threads(GstOpenMptDec *openmpt_dec, gboolean cancel);
+static gboolean gst_openmpt_dec_info_threads_cancelled(GstOpenMptDec *openmpt_dec);
+static gpointer gst_openmpt_dec_info_thread_func(gpointer data);
+static GArray* gst_openmpt_dec_compute_seek_points(GstOpenMptDec *openmpt_dec, openmpt_module *mod, int32_t const *start_orders, guint subsong, double duration);
+static gint gst_openmpt_dec_compare_seek_points(gconstpointer a, gconstpointer b);
+static gst_openmpt_dec_seek_point const * gst_openmpt_dec_find_seek_point(GstOpenMptDec *openmpt_dec, GstClockTime position);
+
 
 
 void gst_openmpt_dec_class_init(GstOpenMptDecClass *klass)
@@ -150,8 +184,16 @@ void gst_openmpt_dec_class_init(GstOpenMptDecClass *klass)
 	object_class->set_property = GST_DEBUG_FUNCPTR(gst_openmpt_dec_set_property);
 	object_class->get_property = GST_DEBUG_FUNCPTR(gst_openmpt_dec_get_property);
 
+	element_class->change_state = GST_DEBUG_FUNCPTR(gst_openmpt_dec_change_state);
+
 	dec_class->seek = GST_DEBUG_FUNCPTR(gst_openmpt_dec_seek);
 	dec_class->tell = GST_DEBUG_FUNCPTR(gst_openmpt_dec_tell);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	dec_class->find_seek_points = GST_DEBUG_FUNCPTR(gst_openmpt_dec_find_seek_points);
+#ifdef HAVE_LIBOPENMPT_EXT
+	dec_class->set_playback_rate = GST_DEBUG_FUNCPTR(gst_openmpt_dec_set_playback_rate);
+#endif
+#endif
 	dec_class->load_from_buffer = GST_DEBUG_FUNCPTR(gst_openmpt_dec_load_from_buffer);
 	dec_class->get_main_tags = GST_DEBUG_FUNCPTR(gst_openmpt_dec_get_main_tags);
 	dec_class->set_num_loops = GST_DEBUG_FUNCPTR(gst_openmpt_dec_set_num_loops);
@@ -163,6 +205,9 @@ void gst_openmpt_dec_class_init(GstOpenMptDecClass *klass)
 	dec_class->get_num_subsongs = GST_DEBUG_FUNCPTR(gst_openmpt_dec_get_num_subsongs);
 	dec_class->get_subsong_duration = GST_DEBUG_FUNCPTR(gst_openmpt_dec_get_subsong_duration);
 	dec_class->get_subsong_tags = GST_DEBUG_FUNCPTR(gst_openmpt_dec_get_subsong_tags);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	dec_class->fill_toc_entry = GST_DEBUG_FUNCPTR(gst_openmpt_dec_fill_toc_entry);
+#endif
 	dec_class->set_subsong_mode = GST_DEBUG_FUNCPTR(gst_openmpt_dec_set_subsong_mode);
 
 	gst_element_class_set_static_metadata(
@@ -233,19 +278,45 @@ void gst_openmpt_dec_class_init(GstOpenMptDecClass *klass)
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_TOC_ROWS,
+		g_param_spec_boolean(
+			"toc-rows",
+			"TOC rows",
+			"Add entries for each pattern row to the TOC, not just for each order (this increases loading time considerably)",
+			DEFAULT_TOC_ROWS,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
 }
 
 
 void gst_openmpt_dec_init(GstOpenMptDec *openmpt_dec)
 {
 	openmpt_dec->mod = NULL;
+#ifdef HAVE_LIBOPENMPT_EXT
+	openmpt_dec->mod_ext = NULL;
+	openmpt_dec->has_interactive = FALSE;
+#endif
 
 	openmpt_dec->cur_subsong = 0;
 	openmpt_dec->num_subsongs = 0;
-	openmpt_dec->subsong_durations = NULL;
 
 	openmpt_dec->num_loops = 0;
 
+	g_mutex_init(&(openmpt_dec->subsong_info_lock));
+	openmpt_dec->subsong_durations = NULL;
+	openmpt_dec->subsong_seek_points = NULL;
+	openmpt_dec->toc_rows = DEFAULT_TOC_ROWS;
+
+	openmpt_dec->module_data = NULL;
+	openmpt_dec->info_toc_rows = DEFAULT_TOC_ROWS;
+	openmpt_dec->info_threads = NULL;
+	openmpt_dec->num_info_threads = 0;
+	openmpt_dec->next_info_subsong = 0;
+	openmpt_dec->info_threads_cancelled = 0;
+
 	openmpt_dec->master_gain = DEFAULT_MASTER_GAIN;
 	openmpt_dec->stereo_separation = DEFAULT_STEREO_SEPARATION;
 	openmpt_dec->filter_length = DEFAULT_FILTER_LENGTH;
@@ -258,6 +329,7 @@ void gst_openmpt_dec_init(GstOpenMptDec *openmpt_dec)
 	openmpt_dec->sample_format = DEFAULT_SAMPLE_FORMAT;
 	openmpt_dec->sample_rate = DEFAULT_SAMPLE_RATE;
 	openmpt_dec->num_channels = DEFAULT_NUM_CHANNELS;
+	openmpt_dec->layout = DEFAULT_LAYOUT;
 }
 
 
@@ -268,18 +340,62 @@ static void gst_openmpt_dec_finalize(GObject *object)
 	g_return_if_fail(GST_IS_OPENMPT_DEC(object));
 	openmpt_dec = GST_OPENMPT_DEC(object);
 
-	if (openmpt_dec->main_tags != NULL)
-		gst_tag_list_unref(openmpt_dec->main_tags);
-
-	if (openmpt_dec->mod != NULL)
-		openmpt_module_destroy(openmpt_dec->mod);
+	gst_openmpt_dec_unload_module(openmpt_dec);
 
-	g_free(openmpt_dec->subsong_durations);
+	g_mutex_clear(&(openmpt_dec->subsong_info_lock));
 
 	G_OBJECT_CLASS(gst_openmpt_dec_parent_class)->finalize(object);
 }
 
 
+static GstStateChangeReturn gst_openmpt_dec_change_state(GstElement *element, GstStateChange transition)
+{
+	GstNonstreamAudioDecoder *dec = GST_NONSTREAM_AUDIO_DECODER(element);
+	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(element);
+	GstStateChangeReturn ret;
+
+	ret = GST_ELEMENT_CLASS(gst_openmpt_dec_parent_class)->change_state(element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+		return ret;
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_READY_TO_PAUSED:
+			/* Resume computing the subsong information if the info threads
+			 * were stopped by an earlier PAUSED->READY state change before
+			 * they were done. If nothing is loaded yet, module_data is NULL,
+			 * and the threads are started by load_from_buffer instead. */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			if ((openmpt_dec->module_data != NULL) && !(dec->metadata_only))
+				gst_openmpt_dec_start_info_threads(openmpt_dec);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+			/* The base class flagged loading as cancelled, so the info
+			 * threads stop at the next subsong or order; wait for them.
+			 * Unfinished subsongs are picked up again in READY->PAUSED. */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gst_openmpt_dec_stop_info_threads(openmpt_dec, TRUE);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		case GST_STATE_CHANGE_READY_TO_NULL:
+			/* The base class reset its state, so the next READY->PAUSED
+			 * state change loads new media */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gst_openmpt_dec_unload_module(openmpt_dec);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		default:
+			break;
+	}
+
+	return ret;
+}
+
+
 static void gst_openmpt_dec_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
 {
 	GstNonstreamAudioDecoder *dec;
@@ -338,6 +454,14 @@ static void gst_openmpt_dec_set_property(GObject *object, guint prop_id, const G
 			break;
 		}
 
+		case PROP_TOC_ROWS:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			openmpt_dec->toc_rows = g_value_get_boolean(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+		}
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -391,6 +515,14 @@ static void gst_openmpt_dec_get_property(GObject *object, guint prop_id, GValue
 			break;
 		}
 
+		case PROP_TOC_ROWS:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
+			g_value_set_boolean(value, openmpt_dec->toc_rows);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			break;
+		}
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -401,9 +533,31 @@ static void gst_openmpt_dec_get_property(GObject *object, guint prop_id, GValue
 static gboolean gst_openmpt_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position)
 {
 	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(dec);
+	gst_openmpt_dec_seek_point const *seek_point;
+	gst_openmpt_dec_seek_point exact_seek_point;
+	gboolean is_exact;
 	g_return_val_if_fail(openmpt_dec->mod != NULL, FALSE);
 
-	openmpt_module_set_position_seconds(openmpt_dec->mod, (double)(*new_position) / GST_SECOND);
+	/* If the position is exactly at the start of an order or row (which is
+	 * the case with TOC entries and KEY_UNIT seeks), use the order and row
+	 * directly, instead of letting OpenMPT search for them by time.
+	 * The seek point is copied, since the info threads may replace
+	 * the array once the lock is released. */
+	g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+	seek_point = gst_openmpt_dec_find_seek_point(openmpt_dec, *new_position);
+	is_exact = (seek_point != NULL) && (seek_point->position == *new_position);
+	if (is_exact)
+		exact_seek_point = *seek_point;
+	g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+
+	if (is_exact)
+	{
+		GST_DEBUG_OBJECT(dec, "seeking to order %d row %d", exact_seek_point.order, exact_seek_point.row);
+		openmpt_module_set_position_order_row(openmpt_dec->mod, exact_seek_point.order, exact_seek_point.row);
+	}
+	else
+		openmpt_module_set_position_seconds(openmpt_dec->mod, (double)(*new_position) / GST_SECOND);
+
 	*new_position = gst_openmpt_dec_tell(dec);
 
 	return TRUE;
@@ -419,6 +573,81 @@ static GstClockTime gst_openmpt_dec_tell(GstNonstreamAudioDecoder *dec)
 }
 
 
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static gboolean gst_openmpt_dec_find_seek_points(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime *point_before, GstClockTime *point_after)
+{
+	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(dec);
+	GArray *seek_point_array;
+	gst_openmpt_dec_seek_point const *seek_points;
+	guint i;
+
+	if ((openmpt_dec->subsong_seek_points == NULL) || (openmpt_dec->cur_subsong_mode != GST_NONSTREM_AUDIO_SUBSONG_MODE_SINGLE))
+		return FALSE;
+
+	g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+
+	/* The seek points of this subsong might not have been computed yet */
+	seek_point_array = openmpt_dec->subsong_seek_points[openmpt_dec->cur_subsong];
+	if (seek_point_array == NULL)
+	{
+		g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+		return FALSE;
+	}
+
+	/* Only order starts are used as seek points here, since the
+	 * pattern starts are the cheapest places to restart playback */
+
+	*point_before = GST_CLOCK_TIME_NONE;
+	*point_after = GST_CLOCK_TIME_NONE;
+
+	seek_points = (gst_openmpt_dec_seek_point const *)(seek_point_array->data);
+	for (i = 0; i < seek_point_array->len; ++i)
+	{
+		if (seek_points[i].row != 0)
+			continue;
+
+		if (seek_points[i].position <= position)
+			*point_before = seek_points[i].position;
+		else
+		{
+			*point_after = seek_points[i].position;
+			break;
+		}
+	}
+
+	g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+
+	return GST_CLOCK_TIME_IS_VALID(*point_before);
+}
+
+
+#ifdef HAVE_LIBOPENMPT_EXT
+static gdouble gst_openmpt_dec_set_playback_rate(GstNonstreamAudioDecoder *dec, gdouble rate)
+{
+	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(dec);
+	gdouble tempo_factor;
+
+	if (!(openmpt_dec->has_interactive))
+		return 1.0;
+
+	/* Changing the tempo makes OpenMPT render fewer (or more) samples per
+	 * second of song time, without altering the pitch. This is much cheaper
+	 * than rendering at normal speed and letting downstream drop data. */
+	tempo_factor = MIN(rate, MAX_TEMPO_FACTOR);
+	if (!(openmpt_dec->interactive.set_tempo_factor(openmpt_dec->mod_ext, tempo_factor)))
+	{
+		GST_WARNING_OBJECT(dec, "could not set tempo factor %f", tempo_factor);
+		return 1.0;
+	}
+
+	GST_DEBUG_OBJECT(dec, "set tempo factor to %f (requested rate: %f)", tempo_factor, rate);
+
+	return tempo_factor;
+}
+#endif
+#endif
+
+
 static void gst_openmpt_dec_log_func(char const *message, void *user)
 {
 	GST_LOG_OBJECT(GST_OBJECT(user), "%s", message);
@@ -468,27 +697,66 @@ static gboolean gst_openmpt_dec_load_from_buffer(GstNonstreamAudioDecoder *dec,
 {
 	GstMapInfo map;
 	GstOpenMptDec *openmpt_dec;
+	GstAudioInfo audio_info;
 	
 	openmpt_dec = GST_OPENMPT_DEC(dec);
 
+	/* Get rid of any previously loaded module and its info threads */
+	gst_openmpt_dec_unload_module(openmpt_dec);
+
 	/* First, determine the sample rate, channel count, and sample format to use */
 	openmpt_dec->sample_format = DEFAULT_SAMPLE_FORMAT;
 	openmpt_dec->sample_rate = DEFAULT_SAMPLE_RATE;
 	openmpt_dec->num_channels = DEFAULT_NUM_CHANNELS;
 	gst_nonstream_audio_decoder_get_downstream_info(dec, &(openmpt_dec->sample_format), &(openmpt_dec->sample_rate), &(openmpt_dec->num_channels));
 
+	/* OpenMPT can render directly into separate channel planes, so
+	 * non-interleaved output is used if downstream asks for it */
+	openmpt_dec->layout = DEFAULT_LAYOUT;
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	gst_nonstream_audio_decoder_get_downstream_layout(dec, &(openmpt_dec->layout));
+#endif
+
 	/* Set output format */
-	if (!gst_nonstream_audio_decoder_set_output_format_simple(
-		dec,
-		openmpt_dec->sample_rate,
-		openmpt_dec->sample_format,
-		openmpt_dec->num_channels
-	))
+	gst_audio_info_init(&audio_info);
+	gst_audio_info_set_format(&audio_info, openmpt_dec->sample_format, openmpt_dec->sample_rate, openmpt_dec->num_channels, NULL);
+	GST_AUDIO_INFO_LAYOUT(&audio_info) = openmpt_dec->layout;
+	if (!gst_nonstream_audio_decoder_set_output_format(dec, &audio_info))
 		return FALSE;
 
-	/* Pass the module data to OpenMPT for loading */
+	/* Pass the module data to OpenMPT for loading
+	 * In metadata-only mode, the sample data is never rendered, so
+	 * let OpenMPT skip loading it (tags and durations do not need it) */
 	gst_buffer_map(source_data, &map, GST_MAP_READ);
-	openmpt_dec->mod = openmpt_module_create_from_memory(map.data, map.size, gst_openmpt_dec_log_func, dec, NULL);
+	{
+		openmpt_module_initial_ctl const metadata_only_ctls[] =
+		{
+			{ "load.skip_samples", "1" },
+			{ NULL, NULL }
+		};
+		openmpt_module_initial_ctl const *ctls = NULL;
+
+		if (dec->metadata_only)
+		{
+			GST_DEBUG_OBJECT(dec, "metadata-only mode - not loading sample data");
+			ctls = metadata_only_ctls;
+		}
+
+#ifdef HAVE_LIBOPENMPT_EXT
+		/* The extended module provides the interactive interface, which is
+		 * used for changing the tempo (see gst_openmpt_dec_set_playback_rate) */
+		openmpt_dec->mod_ext = openmpt_module_ext_create_from_memory(map.data, map.size, gst_openmpt_dec_log_func, dec, NULL, NULL, NULL, NULL, ctls);
+		if (openmpt_dec->mod_ext != NULL)
+		{
+			openmpt_dec->mod = openmpt_module_ext_get_module(openmpt_dec->mod_ext);
+			openmpt_dec->has_interactive = openmpt_module_ext_get_interface(openmpt_dec->mod_ext, LIBOPENMPT_EXT_C_INTERFACE_INTERACTIVE, &(openmpt_dec->interactive), sizeof(openmpt_dec->interactive)) != 0;
+			if (!(openmpt_dec->has_interactive))
+				GST_INFO_OBJECT(dec, "interactive interface not available - cannot change tempo");
+		}
+#else
+		openmpt_dec->mod = openmpt_module_create_from_memory(map.data, map.size, gst_openmpt_dec_log_func, dec, ctls);
+#endif
+	}
 	gst_buffer_unmap(source_data, &map);
 
 	if (openmpt_dec->mod == NULL)
@@ -539,17 +807,11 @@ static gboolean gst_openmpt_dec_load_from_buffer(GstNonstreamAudioDecoder *dec,
 		}
 	}
 
-	/* Seek to initial position */
-	if (*initial_position != 0)
-	{
-		openmpt_module_set_position_seconds(openmpt_dec->mod, (double)(*initial_position) / GST_SECOND);
-		*initial_position = (GstClockTime)(openmpt_module_get_position_seconds(openmpt_dec->mod) * GST_SECOND);
-	}
-
 	/* LOOPING output mode is not supported */
 	*initial_output_mode = GST_NONSTREM_AUDIO_OUTPUT_MODE_STEADY;
 
-	/* Query the durations of each subsong (if any exist) */
+	/* Allocate the per-subsong information arrays (if any subsongs exist).
+	 * They are filled by the info threads, which are started below. */
 	if (openmpt_dec->num_subsongs > 0)
 	{
 		guint i;
@@ -564,17 +826,50 @@ static gboolean gst_openmpt_dec_load_from_buffer(GstNonstreamAudioDecoder *dec,
 		}
 
 		for (i = 0; i < openmpt_dec->num_subsongs; ++i)
-		{
-			openmpt_module_select_subsong(openmpt_dec->mod, i);
-			openmpt_dec->subsong_durations[i] = openmpt_module_get_duration_seconds(openmpt_dec->mod);
-		}
+			openmpt_dec->subsong_durations[i] = -1.0;
+
+		openmpt_dec->subsong_seek_points = g_new0(GArray *, openmpt_dec->num_subsongs);
 	}
 
 	/* Select the initial subsong */
 	gst_openmpt_dec_select_subsong(openmpt_dec, initial_subsong_mode, initial_subsong);
 
+	/* The duration of the initial subsong is needed right away (for the
+	 * initial duration query and the first segment), and OpenMPT already
+	 * knows it, so it is not left to the info threads */
+	if ((initial_subsong_mode == GST_NONSTREM_AUDIO_SUBSONG_MODE_SINGLE) && (openmpt_dec->num_subsongs > 0))
+		openmpt_dec->subsong_durations[initial_subsong] = openmpt_module_get_duration_seconds(openmpt_dec->mod);
+
+	/* Seek to initial position; this must happen after the initial subsong
+	 * is selected, since selecting a subsong resets the position */
+	if (!(dec->metadata_only) && (*initial_position != 0))
+	{
+		openmpt_module_set_position_seconds(openmpt_dec->mod, (double)(*initial_position) / GST_SECOND);
+		*initial_position = (GstClockTime)(openmpt_module_get_position_seconds(openmpt_dec->mod) * GST_SECOND);
+	}
+
+	/* Compute the remaining durations and the order (and row) start
+	 * positions in the background, on separate module instances, so
+	 * playback can begin immediately. In metadata-only mode, there is
+	 * no playback, and all of the information is needed before the
+	 * TOC is produced, so wait for the threads to finish. The same
+	 * goes for base classes that cannot be notified about updated
+	 * subsong information. */
+	if (openmpt_dec->num_subsongs > 0)
+	{
+		openmpt_dec->module_data = gst_buffer_ref(source_data);
+		gst_openmpt_dec_start_info_threads(openmpt_dec);
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+		if (dec->metadata_only)
+			gst_openmpt_dec_stop_info_threads(openmpt_dec, FALSE);
+#else
+		gst_openmpt_dec_stop_info_threads(openmpt_dec, FALSE);
+#endif
+	}
+
 	/* Set the number of loops, and query the actual number
 	 * that was chosen by OpenMPT */
+	if (!(dec->metadata_only))
 	{
 		int32_t actual_repeat_count;
 		openmpt_module_set_repeat_count(openmpt_dec->mod, *initial_num_loops);
@@ -588,10 +883,13 @@ static gboolean gst_openmpt_dec_load_from_buffer(GstNonstreamAudioDecoder *dec,
 	}
 
 	/* Set render parameters (adjustable via properties) */
-	openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_MASTERGAIN_MILLIBEL, openmpt_dec->master_gain);
-	openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_STEREOSEPARATION_PERCENT, openmpt_dec->stereo_separation);
-	openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_INTERPOLATIONFILTER_LENGTH, openmpt_dec->filter_length);
-	openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_VOLUMERAMPING_STRENGTH, openmpt_dec->volume_ramping);
+	if (!(dec->metadata_only))
+	{
+		openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_MASTERGAIN_MILLIBEL, openmpt_dec->master_gain);
+		openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_STEREOSEPARATION_PERCENT, openmpt_dec->stereo_separation);
+		openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_INTERPOLATIONFILTER_LENGTH, openmpt_dec->filter_length);
+		openmpt_module_set_render_param(openmpt_dec->mod, OPENMPT_MODULE_RENDER_VOLUMERAMPING_STRENGTH, openmpt_dec->volume_ramping);
+	}
 
 	/* Log the available metadata keys, and produce a
 	 * tag list if any keys are available */
@@ -680,7 +978,15 @@ static guint gst_openmpt_dec_get_num_subsongs(GstNonstreamAudioDecoder *dec)
 static GstClockTime gst_openmpt_dec_get_subsong_duration(GstNonstreamAudioDecoder *dec, guint subsong)
 {
 	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(dec);
-	return (GstClockTime)(openmpt_dec->subsong_durations[subsong] * GST_SECOND);
+	double duration;
+
+	g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+	duration = openmpt_dec->subsong_durations[subsong];
+	g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+
+	/* The duration is not known yet if the info threads did not get to this
+	 * subsong so far; the base class is notified once they do */
+	return (duration < 0.0) ? GST_CLOCK_TIME_NONE : (GstClockTime)(duration * GST_SECOND);
 }
 
 
@@ -711,6 +1017,96 @@ static GstTagList* gst_openmpt_dec_get_subsong_tags(GstNonstreamAudioDecoder *de
 }
 
 
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+static void gst_openmpt_dec_fill_toc_entry(GstNonstreamAudioDecoder *dec, guint subsong, GstTocEntry *entry)
+{
+	GstOpenMptDec *openmpt_dec;
+	GArray *seek_point_array;
+	gst_openmpt_dec_seek_point const *seek_points;
+	guint i, j, num_seek_points;
+	GstClockTime duration;
+	GstTocEntry *order_entry = NULL;
+
+	openmpt_dec = GST_OPENMPT_DEC(dec);
+
+	if (openmpt_dec->subsong_seek_points == NULL)
+		return;
+
+	g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+
+	/* If the info threads did not get to this subsong yet, the entry stays
+	 * empty; the TOC is updated once the seek points are available */
+	seek_point_array = openmpt_dec->subsong_seek_points[subsong];
+	if (seek_point_array == NULL)
+	{
+		g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+		return;
+	}
+
+	seek_points = (gst_openmpt_dec_seek_point const *)(seek_point_array->data);
+	num_seek_points = seek_point_array->len;
+	duration = (GstClockTime)(openmpt_dec->subsong_durations[subsong] * GST_SECOND);
+
+	/* Orders become chapters of the subsong entry, rows become
+	 * chapters of the order entries. Each entry ends where the
+	 * next one of the same kind begins. */
+	for (i = 0; i < num_seek_points; ++i)
+	{
+		gst_openmpt_dec_seek_point const *seek_point = &(seek_points[i]);
+		GstClockTime stop = duration;
+		GstTocEntry *sub_entry;
+		GstTagList *tags;
+		gchar *uid, *title;
+
+		if (seek_point->row == 0)
+		{
+			for (j = i + 1; j < num_seek_points; ++j)
+			{
+				if (seek_points[j].row == 0)
+				{
+					stop = seek_points[j].position;
+					break;
+				}
+			}
+
+			uid = g_strdup_printf("openmpt-subsong-%05u-order-%05d", subsong, seek_point->order);
+			title = g_strdup_printf("Order %d", seek_point->order);
+		}
+		else if (order_entry != NULL)
+		{
+			if ((i + 1) < num_seek_points)
+				stop = seek_points[i + 1].position;
+
+			uid = g_strdup_printf("openmpt-subsong-%05u-order-%05d-row-%05d", subsong, seek_point->order, seek_point->row);
+			title = g_strdup_printf("Order %d row %d", seek_point->order, seek_point->row);
+		}
+		else
+			continue;
+
+		sub_entry = gst_toc_entry_new(GST_TOC_ENTRY_TYPE_CHAPTER, uid);
+		gst_toc_entry_set_start_stop_times(sub_entry, seek_point->position, stop);
+
+		tags = gst_tag_list_new_empty();
+		gst_tag_list_add(tags, GST_TAG_MERGE_REPLACE, GST_TAG_TITLE, title, NULL);
+		gst_toc_entry_set_tags(sub_entry, tags);
+
+		if (seek_point->row == 0)
+		{
+			gst_toc_entry_append_sub_entry(entry, sub_entry);
+			order_entry = sub_entry;
+		}
+		else
+			gst_toc_entry_append_sub_entry(order_entry, sub_entry);
+
+		g_free(uid);
+		g_free(title);
+	}
+
+	g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+}
+#endif
+
+
 static gboolean gst_openmpt_dec_set_subsong_mode(GstNonstreamAudioDecoder *dec, GstNonstreamAudioSubsongMode mode, GstClockTime *initial_position)
 {
 	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(dec);
@@ -790,57 +1186,135 @@ static gboolean gst_openmpt_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer
 
 	gst_buffer_map(outbuf, &map, GST_MAP_WRITE);
 
-	switch (openmpt_dec->sample_format)
+	if (openmpt_dec->layout == GST_AUDIO_LAYOUT_NON_INTERLEAVED)
 	{
-		case GST_AUDIO_FORMAT_S16:
+		/* Render directly into the planes, which are stored back to back,
+		 * each with room for output_buffer_size samples */
+
+		gsize plane_size = openmpt_dec->output_buffer_size * (fmt_info->width / 8);
+		guint8 *planes[4];
+		gint i;
+
+		for (i = 0; i < openmpt_dec->num_channels; ++i)
+			planes[i] = map.data + i * plane_size;
+
+		switch (openmpt_dec->sample_format)
 		{
-			int16_t *out_samples = (int16_t*)(map.data);
-			switch (openmpt_dec->num_channels)
+			case GST_AUDIO_FORMAT_S16:
 			{
-				case 1:
-					num_read_samples = openmpt_module_read_mono(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
-					break;
-				case 2:
-					num_read_samples = openmpt_module_read_interleaved_stereo(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
-					break;
-				case 4:
-					num_read_samples = openmpt_module_read_interleaved_quad(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
-					break;
-				default:
-					g_assert_not_reached();
+				switch (openmpt_dec->num_channels)
+				{
+					case 1:
+						num_read_samples = openmpt_module_read_mono(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, (int16_t*)(planes[0]));
+						break;
+					case 2:
+						num_read_samples = openmpt_module_read_stereo(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, (int16_t*)(planes[0]), (int16_t*)(planes[1]));
+						break;
+					case 4:
+						num_read_samples = openmpt_module_read_quad(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, (int16_t*)(planes[0]), (int16_t*)(planes[1]), (int16_t*)(planes[2]), (int16_t*)(planes[3]));
+						break;
+					default:
+						g_assert_not_reached();
+				}
+				break;
 			}
-			break;
-		}
-		case GST_AUDIO_FORMAT_F32:
-		{
-			float *out_samples = (float*)(map.data);
-			switch (openmpt_dec->num_channels)
+			case GST_AUDIO_FORMAT_F32:
 			{
-				case 1:
-					num_read_samples = openmpt_module_read_float_mono(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
-					break;
-				case 2:
-					num_read_samples = openmpt_module_read_interleaved_float_stereo(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
-					break;
-				case 4:
-					num_read_samples = openmpt_module_read_interleaved_float_quad(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
-					break;
-				default:
-					g_assert_not_reached();
+				switch (openmpt_dec->num_channels)
+				{
+					case 1:
+						num_read_samples = openmpt_module_read_float_mono(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, (float*)(planes[0]));
+						break;
+					case 2:
+						num_read_samples = openmpt_module_read_float_stereo(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, (float*)(planes[0]), (float*)(planes[1]));
+						break;
+					case 4:
+						num_read_samples = openmpt_module_read_float_quad(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, (float*)(planes[0]), (float*)(planes[1]), (float*)(planes[2]), (float*)(planes[3]));
+						break;
+					default:
+						g_assert_not_reached();
+				}
+				break;
+			}
+			default:
+			{
+				GST_ERROR_OBJECT(dec, "using unsupported sample format %s", fmt_info->name);
+				g_assert_not_reached();
 			}
-			break;
 		}
-		default:
+	}
+	else
+	{
+		switch (openmpt_dec->sample_format)
 		{
-			GST_ERROR_OBJECT(dec, "using unsupported sample format %s", fmt_info->name);
-			g_assert_not_reached();
+			case GST_AUDIO_FORMAT_S16:
+			{
+				int16_t *out_samples = (int16_t*)(map.data);
+				switch (openmpt_dec->num_channels)
+				{
+					case 1:
+						num_read_samples = openmpt_module_read_mono(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
+						break;
+					case 2:
+						num_read_samples = openmpt_module_read_interleaved_stereo(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
+						break;
+					case 4:
+						num_read_samples = openmpt_module_read_interleaved_quad(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
+						break;
+					default:
+						g_assert_not_reached();
+				}
+				break;
+			}
+			case GST_AUDIO_FORMAT_F32:
+			{
+				float *out_samples = (float*)(map.data);
+				switch (openmpt_dec->num_channels)
+				{
+					case 1:
+						num_read_samples = openmpt_module_read_float_mono(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
+						break;
+					case 2:
+						num_read_samples = openmpt_module_read_interleaved_float_stereo(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
+						break;
+					case 4:
+						num_read_samples = openmpt_module_read_interleaved_float_quad(openmpt_dec->mod, openmpt_dec->sample_rate, openmpt_dec->output_buffer_size, out_samples);
+						break;
+					default:
+						g_assert_not_reached();
+				}
+				break;
+			}
+			default:
+			{
+				GST_ERROR_OBJECT(dec, "using unsupported sample format %s", fmt_info->name);
+				g_assert_not_reached();
+			}
 		}
 	}
 
 	gst_buffer_unmap(outbuf, &map);
 
 	if (num_read_samples == 0)
+	{
+		gst_buffer_unref(outbuf);
 		return FALSE;
+	}
+
+#if GST_CHECK_VERSION(1, 16, 0)
+	/* If fewer samples were read than there is room for, the planes
+	 * are not back to back, so their offsets have to be specified */
+	if (openmpt_dec->layout == GST_AUDIO_LAYOUT_NON_INTERLEAVED)
+	{
+		gsize offsets[4];
+		gint i;
+
+		for (i = 0; i < openmpt_dec->num_channels; ++i)
+			offsets[i] = i * openmpt_dec->output_buffer_size * (fmt_info->width / 8);
+
+		gst_buffer_add_audio_meta(outbuf, &(dec->output_audio_info), num_read_samples, offsets);
+	}
+#endif
 
 	*buffer = outbuf;
 	*num_samples = num_read_samples;
@@ -876,3 +1350,350 @@ static gboolean gst_openmpt_dec_select_subsong(GstOpenMptDec *openmpt_dec, GstNo
 			return TRUE;
 	}
 }
+
+
+static void gst_openmpt_dec_unload_module(GstOpenMptDec *openmpt_dec)
+{
+	/* The info threads access the module data and the
+	 * subsong information arrays, so they must be gone first */
+	gst_openmpt_dec_stop_info_threads(openmpt_dec, TRUE);
+
+	if (openmpt_dec->module_data != NULL)
+	{
+		gst_buffer_unref(openmpt_dec->module_data);
+		openmpt_dec->module_data = NULL;
+	}
+
+	if (openmpt_dec->main_tags != NULL)
+	{
+		gst_tag_list_unref(openmpt_dec->main_tags);
+		openmpt_dec->main_tags = NULL;
+	}
+
+#ifdef HAVE_LIBOPENMPT_EXT
+	if (openmpt_dec->mod_ext != NULL)
+	{
+		openmpt_module_ext_destroy(openmpt_dec->mod_ext);
+		openmpt_dec->mod_ext = NULL;
+	}
+	openmpt_dec->has_interactive = FALSE;
+#else
+	if (openmpt_dec->mod != NULL)
+		openmpt_module_destroy(openmpt_dec->mod);
+#endif
+	openmpt_dec->mod = NULL;
+
+	g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+
+	if (openmpt_dec->subsong_seek_points != NULL)
+	{
+		guint i;
+		for (i = 0; i < openmpt_dec->num_subsongs; ++i)
+		{
+			if (openmpt_dec->subsong_seek_points[i] != NULL)
+				g_array_free(openmpt_dec->subsong_seek_points[i], TRUE);
+		}
+		g_free(openmpt_dec->subsong_seek_points);
+		openmpt_dec->subsong_seek_points = NULL;
+	}
+
+	g_free(openmpt_dec->subsong_durations);
+	openmpt_dec->subsong_durations = NULL;
+
+	g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+
+	openmpt_dec->num_subsongs = 0;
+}
+
+
+static void gst_openmpt_dec_start_info_threads(GstOpenMptDec *openmpt_dec)
+{
+	/* Must be called with the decoder mutex held */
+
+	guint i, num_threads, num_missing;
+
+	if (openmpt_dec->info_threads != NULL)
+	{
+		GST_DEBUG_OBJECT(openmpt_dec, "subsong info threads are already running");
+		return;
+	}
+
+	/* Subsongs whose information was computed before the threads were
+	 * last stopped are skipped; if none are left, there is nothing to do */
+	num_missing = 0;
+	g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+	for (i = 0; i < openmpt_dec->num_subsongs; ++i)
+	{
+		if (openmpt_dec->subsong_seek_points[i] == NULL)
+			++num_missing;
+	}
+	g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+
+	if (num_missing == 0)
+	{
+		GST_DEBUG_OBJECT(openmpt_dec, "information of all subsongs is already known");
+		return;
+	}
+
+	/* One thread per processor is enough, since each thread picks
+	 * the next unprocessed subsong once it is done with one */
+	num_threads = MIN(num_missing, g_get_num_processors());
+
+	/* The threads must not read the property while it can be
+	 * changed, so they use a copy made at the time they start */
+	openmpt_dec->info_toc_rows = openmpt_dec->toc_rows;
+
+	openmpt_dec->next_info_subsong = 0;
+	openmpt_dec->info_threads_cancelled = 0;
+	openmpt_dec->info_threads = g_new0(GThread *, num_threads);
+	openmpt_dec->num_info_threads = 0;
+
+	for (i = 0; i < num_threads; ++i)
+	{
+		GError *error = NULL;
+		GThread *thread = g_thread_try_new("openmptdec-info", gst_openmpt_dec_info_thread_func, openmpt_dec, &error);
+
+		if (thread == NULL)
+		{
+			GST_WARNING_OBJECT(openmpt_dec, "could not create subsong info thread: %s", error->message);
+			g_error_free(error);
+			break;
+		}
+
+		openmpt_dec->info_threads[openmpt_dec->num_info_threads++] = thread;
+	}
+
+	GST_DEBUG_OBJECT(openmpt_dec, "started %u subsong info thread(s) for %u subsong(s)", openmpt_dec->num_info_threads, num_missing);
+
+	/* If no thread could be created, do the work right here */
+	if (openmpt_dec->num_info_threads == 0)
+	{
+		g_free(openmpt_dec->info_threads);
+		openmpt_dec->info_threads = NULL;
+		gst_openmpt_dec_info_thread_func(openmpt_dec);
+	}
+}
+
+
+static void gst_openmpt_dec_stop_info_threads(GstOpenMptDec *openmpt_dec, gboolean cancel)
+{
+	/* Joins the info threads. The module data is kept, so the threads
+	 * can be started again for the subsongs they did not get to.
+	 * Must be called with the decoder mutex held (except in finalize). */
+
+	guint i;
+
+	if (cancel)
+		g_atomic_int_set(&(openmpt_dec->info_threads_cancelled), 1);
+
+	for (i = 0; i < openmpt_dec->num_info_threads; ++i)
+		g_thread_join(openmpt_dec->info_threads[i]);
+
+	g_free(openmpt_dec->info_threads);
+	openmpt_dec->info_threads = NULL;
+	openmpt_dec->num_info_threads = 0;
+}
+
+
+static gboolean gst_openmpt_dec_info_threads_cancelled(GstOpenMptDec *openmpt_dec)
+{
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	if (gst_nonstream_audio_decoder_is_loading_cancelled(GST_NONSTREAM_AUDIO_DECODER(openmpt_dec)))
+		return TRUE;
+#endif
+	return g_atomic_int_get(&(openmpt_dec->info_threads_cancelled));
+}
+
+
+static gpointer gst_openmpt_dec_info_thread_func(gpointer data)
+{
+	GstOpenMptDec *openmpt_dec = GST_OPENMPT_DEC(data);
+	GstMapInfo map;
+	openmpt_module *mod;
+	int32_t *start_orders;
+	guint subsong;
+
+	/* OpenMPT modules cannot be shared between threads, so each thread
+	 * loads its own instance. Durations and order start positions do
+	 * not depend on the sample data, so that is not loaded. */
+	openmpt_module_initial_ctl const info_ctls[] =
+	{
+		{ "load.skip_samples", "1" },
+		{ "load.skip_plugins", "1" },
+		{ NULL, NULL }
+	};
+
+	gst_buffer_map(openmpt_dec->module_data, &map, GST_MAP_READ);
+	mod = openmpt_module_create_from_memory(map.data, map.size, gst_openmpt_dec_log_func, openmpt_dec, info_ctls);
+	gst_buffer_unmap(openmpt_dec->module_data, &map);
+
+	if (mod == NULL)
+	{
+		GST_WARNING_OBJECT(openmpt_dec, "could not load module for subsong info thread");
+		return NULL;
+	}
+
+	/* OpenMPT does not tell which orders belong to which subsong. But
+	 * selecting a subsong moves the position to its first order, so each
+	 * order is attributed to the subsong with the closest preceding start. */
+	start_orders = g_new(int32_t, openmpt_dec->num_subsongs);
+	for (subsong = 0; subsong < openmpt_dec->num_subsongs; ++subsong)
+	{
+		openmpt_module_select_subsong(mod, subsong);
+		start_orders[subsong] = openmpt_module_get_current_order(mod);
+	}
+
+	while (TRUE)
+	{
+		double duration;
+		GArray *seek_points;
+
+		gboolean done;
+
+		subsong = (guint)g_atomic_int_add(&(openmpt_dec->next_info_subsong), 1);
+		if (subsong >= openmpt_dec->num_subsongs)
+			break;
+
+		/* skip subsongs that were done before the threads were restarted */
+		g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+		done = (openmpt_dec->subsong_seek_points[subsong] != NULL);
+		g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+		if (done)
+			continue;
+
+		openmpt_module_select_subsong(mod, subsong);
+		duration = openmpt_module_get_duration_seconds(mod);
+
+		seek_points = gst_openmpt_dec_compute_seek_points(openmpt_dec, mod, start_orders, subsong, duration);
+		if (seek_points == NULL)
+		{
+			GST_DEBUG_OBJECT(openmpt_dec, "subsong info thread was cancelled");
+			break;
+		}
+
+		g_mutex_lock(&(openmpt_dec->subsong_info_lock));
+		openmpt_dec->subsong_durations[subsong] = duration;
+		openmpt_dec->subsong_seek_points[subsong] = seek_points;
+		g_mutex_unlock(&(openmpt_dec->subsong_info_lock));
+
+		GST_DEBUG_OBJECT(openmpt_dec, "subsong %u: duration %f seconds, %u seek points", subsong, duration, seek_points->len);
+
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+		gst_nonstream_audio_decoder_subsong_info_changed(GST_NONSTREAM_AUDIO_DECODER(openmpt_dec));
+#endif
+	}
+
+	g_free(start_orders);
+	openmpt_module_destroy(mod);
+
+	return NULL;
+}
+
+
+static GArray* gst_openmpt_dec_compute_seek_points(GstOpenMptDec *openmpt_dec, openmpt_module *mod, int32_t const *start_orders, guint subsong, double duration)
+{
+	/* Returns the seek points of the given subsong, sorted by position,
+	 * or NULL if the computation was cancelled */
+
+	guint s;
+	int32_t num_orders, num_patterns, order, row, num_rows;
+	GArray *seek_points;
+
+	seek_points = g_array_new(FALSE, FALSE, sizeof(gst_openmpt_dec_seek_point));
+
+	num_orders = openmpt_module_get_num_orders(mod);
+	num_patterns = openmpt_module_get_num_patterns(mod);
+
+	for (order = 0; order < num_orders; ++order)
+	{
+		int32_t pattern;
+		gint order_subsong = -1;
+
+		/* Computing the start times can take a while with large modules */
+		if (gst_openmpt_dec_info_threads_cancelled(openmpt_dec))
+		{
+			g_array_free(seek_points, TRUE);
+			return NULL;
+		}
+
+		/* skip separator and end-of-song markers */
+		pattern = openmpt_module_get_order_pattern(mod, order);
+		if ((pattern < 0) || (pattern >= num_patterns))
+			continue;
+
+		for (s = 0; s < openmpt_dec->num_subsongs; ++s)
+		{
+			if ((start_orders[s] <= order) && ((order_subsong < 0) || (start_orders[s] > start_orders[order_subsong])))
+				order_subsong = s;
+		}
+		/* orders before the first subsong start go to the first subsong */
+		if (order_subsong < 0)
+			order_subsong = 0;
+		if ((guint)order_subsong != subsong)
+			continue;
+
+		num_rows = openmpt_dec->info_toc_rows ? openmpt_module_get_pattern_num_rows(mod, pattern) : 1;
+
+		for (row = 0; row < num_rows; ++row)
+		{
+			gst_openmpt_dec_seek_point seek_point;
+			double seconds = openmpt_module_set_position_order_row(mod, order, row);
+
+			/* rows that are never reached in this subsong do not have a usable start time */
+			if ((seconds < 0.0) || (seconds >= duration))
+				continue;
+
+			seek_point.position = (GstClockTime)(seconds * GST_SECOND);
+			seek_point.order = order;
+			seek_point.row = row;
+			g_array_append_val(seek_points, seek_point);
+		}
+	}
+
+	g_array_sort(seek_points, gst_openmpt_dec_compare_seek_points);
+
+	return seek_points;
+}
+
+
+static gint gst_openmpt_dec_compare_seek_points(gconstpointer a, gconstpointer b)
+{
+	gst_openmpt_dec_seek_point const *point_a = (gst_openmpt_dec_seek_point const *)a;
+	gst_openmpt_dec_seek_point const *point_b = (gst_openmpt_dec_seek_point const *)b;
+
+	if (point_a->position != point_b->position)
+		return (point_a->position < point_b->position) ? -1 : 1;
+	else
+		return 0;
+}
+
+
+static gst_openmpt_dec_seek_point const * gst_openmpt_dec_find_seek_point(GstOpenMptDec *openmpt_dec, GstClockTime position)
+{
+	/* Returns the last seek point of the current subsong that is <= position
+	 * Must be called with the subsong info lock held */
+
+	GArray *seek_point_array;
+	gst_openmpt_dec_seek_point const *seek_points;
+	gst_openmpt_dec_seek_point const *found = NULL;
+	guint i;
+
+	/* seek point positions are relative to the subsong start,
+	 * so they are of no use if all subsongs are played */
+	if ((openmpt_dec->subsong_seek_points == NULL) || (openmpt_dec->cur_subsong_mode != GST_NONSTREM_AUDIO_SUBSONG_MODE_SINGLE))
+		return NULL;
+
+	seek_point_array = openmpt_dec->subsong_seek_points[openmpt_dec->cur_subsong];
+	if (seek_point_array == NULL)
+		return NULL;
+
+	seek_points = (gst_openmpt_dec_seek_point const *)(seek_point_array->data);
+	for (i = 0; i < seek_point_array->len; ++i)
+	{
+		if (seek_points[i].position > position)
+			break;
+		found = &(seek_points[i]);
+	}
+
+	return found;
+}
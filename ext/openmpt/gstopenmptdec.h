@@ -25,6 +25,9 @@
 #include <gst/gst.h>
 #include "gst/audio/gstnonstreamaudiodecoder.h"
 #include <libopenmpt/libopenmpt.h>
+#ifdef HAVE_LIBOPENMPT_EXT
+#include <libopenmpt/libopenmpt_ext.h>
+#endif
 
 
 G_BEGIN_DECLS
@@ -41,13 +44,27 @@ typedef struct _GstOpenMptDecClass GstOpenMptDecClass;
 #define GST_IS_OPENMPT_DEC_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_OPENMPT_DEC))
 
 
+typedef struct
+{
+	GstClockTime position;
+	gint32 order, row;
+}
+gst_openmpt_dec_seek_point;
+
+
 struct _GstOpenMptDec
 {
 	GstNonstreamAudioDecoder parent;
 	openmpt_module *mod;
 
+#ifdef HAVE_LIBOPENMPT_EXT
+	/* if this is set, mod belongs to mod_ext */
+	openmpt_module_ext *mod_ext;
+	openmpt_module_ext_interface_interactive interactive;
+	gboolean has_interactive;
+#endif
+
 	guint cur_subsong, num_subsongs;
-	double *subsong_durations;
 	/* NOTE: this is of type int, not guint, because the value
 	 * is defined by OpenMPT, and can be -1 (= "all subsongs") */
 	int default_openmpt_subsong;
@@ -55,9 +72,33 @@ struct _GstOpenMptDec
 
 	gint num_loops;
 
+	/* Per-subsong durations (negative if not known yet) and order (and
+	 * optionally row) start positions (one position-sorted GArray per
+	 * subsong, NULL if not known yet); used for the TOC and for seeking.
+	 * These are filled in by the subsong info threads, which work on their
+	 * own module instances, created out of module_data. The arrays are
+	 * protected by subsong_info_lock. If both this lock and the decoder
+	 * mutex are taken, the decoder mutex must be taken first. */
+	GMutex subsong_info_lock;
+	double *subsong_durations;
+	GArray **subsong_seek_points;
+	gboolean toc_rows;
+
+	/* module_data is kept until the module is unloaded, so the info
+	 * threads can resume after they were stopped by a PAUSED->READY
+	 * state change. info_toc_rows is the toc_rows value the running
+	 * threads use. */
+	GstBuffer *module_data;
+	gboolean info_toc_rows;
+	GThread **info_threads;
+	guint num_info_threads;
+	volatile gint next_info_subsong;
+	volatile gint info_threads_cancelled;
+
 	gint master_gain, stereo_separation, filter_length, volume_ramping;
 
 	GstAudioFormat sample_format;
+	GstAudioLayout layout;
 	gint sample_rate, num_channels;
 
 	guint output_buffer_size;
@@ -63,6 +63,8 @@ GST_DEBUG_CATEGORY_STATIC(sidplayfpdec_debug);
 #define DEFAULT_DEFAULT_SID_MODEL SidConfig::MOS6581
 #define DEFAULT_FORCE_SID_MODEL FALSE
 #define DEFAULT_SAMPLING_METHOD SidConfig::RESAMPLE_INTERPOLATE
+#define DEFAULT_FAST_SAMPLING FALSE
+#define DEFAULT_PROBE_DURATIONS FALSE
 
 
 enum
@@ -76,8 +78,10 @@ enum
 	PROP_DEFAULT_SID_MODEL,
 	PROP_FORCE_SID_MODEL,
 	PROP_SAMPLING_METHOD,
+	PROP_FAST_SAMPLING,
 	PROP_FALLBACK_SONG_LENGTH,
 	PROP_HSVC_SONGLENGTH_DB_PATH,
+	PROP_PROBE_DURATIONS,
 	PROP_OUTPUT_BUFFER_SIZE
 };
 
@@ -89,6 +93,24 @@ enum
 #define DEFAULT_FALLBACK_SONG_LENGTH (3*60 + 30)
 #define DEFAULT_HSVC_SONGLENGTH_DB_PATH NULL
 
+/* Playback speed while seeking, in percent; 3200% is the
+ * maximum sidplayfp's fastForward() accepts */
+#define SEEK_FAST_FORWARD_PERCENT 3200
+/* Number of chunks per second the last second before the seek target
+ * is emulated in (at normal speed, to find the second boundary) */
+#define SEEK_CHUNKS_PER_SECOND 100
+
+/* Duration probing parameters; see gst_sidplayfp_dec_probe_subsong_length() */
+#define MAX_PROBE_THREADS 4
+#define MAX_PROBE_CACHE_ENTRIES 4096
+#define PROBE_SAMPLE_RATE 22050
+#define PROBE_BLOCKS_PER_SECOND 10
+#define PROBE_BLOCK_SIZE (PROBE_SAMPLE_RATE / PROBE_BLOCKS_PER_SECOND)
+#define PROBE_SILENCE_THRESHOLD 64
+#define PROBE_SILENCE_BLOCKS (3 * PROBE_BLOCKS_PER_SECOND)
+#define PROBE_MIN_LOOP_BLOCKS (10 * PROBE_BLOCKS_PER_SECOND)
+#define PROBE_MIN_FINGERPRINT_RANGE 4
+
 
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
@@ -118,12 +140,21 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
 G_DEFINE_TYPE(GstSidplayfpDec, gst_sidplayfp_dec, GST_TYPE_NONSTREAM_AUDIO_DECODER)
 
 
+/* Process-wide cache of probed subsong lengths, keyed by MD5 and probe
+ * length limit; values are arrays with one length per subsong */
+G_LOCK_DEFINE_STATIC(probe_cache);
+static GHashTable *probe_cache = NULL;
+
+
 
 static void gst_sidplayfp_dec_finalize(GObject *object);
+static GstStateChangeReturn gst_sidplayfp_dec_change_state(GstElement *element, GstStateChange transition);
+static void gst_sidplayfp_dec_unload(GstSidplayfpDec *sidplayfp_dec);
 
 static void gst_sidplayfp_dec_set_property(GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void gst_sidplayfp_dec_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 
+static gboolean gst_sidplayfp_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position);
 static GstClockTime gst_sidplayfp_dec_tell(GstNonstreamAudioDecoder *dec);
 
 static gboolean gst_sidplayfp_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *source_data, guint initial_subsong, GstNonstreamAudioSubsongMode initial_subsong_mode, GstClockTime *initial_position, GstNonstreamAudioOutputMode *initial_output_mode, gint *initial_num_loops);
@@ -143,6 +174,21 @@ static gint gst_sidplayfp_dec_get_num_loops(GstNonstreamAudioDecoder *dec);
 static guint gst_sidplayfp_dec_get_supported_output_modes(GstNonstreamAudioDecoder *dec);
 static gboolean gst_sidplayfp_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffer **buffer, guint *num_samples);
 
+static gboolean gst_sidplayfp_dec_setup_engine(GstSidplayfpDec *sidplayfp_dec);
+static void gst_sidplayfp_dec_init_engine_config(GstSidplayfpDec *sidplayfp_dec, gst_sidplayfp_dec_engine_config *config, gint sample_rate, gint num_channels, gboolean fast_sampling);
+static void gst_sidplayfp_dec_clear_engine_config(gst_sidplayfp_dec_engine_config *config);
+static GstSidplayfpPooledEngine* gst_sidplayfp_dec_acquire_engine(GstSidplayfpDec *sidplayfp_dec, gst_sidplayfp_dec_engine_config const *config);
+static gchar* gst_sidplayfp_dec_get_engine_config_key(gst_sidplayfp_dec_engine_config const *config);
+static gboolean gst_sidplayfp_dec_start_subsong(GstSidplayfpDec *sidplayfp_dec, SidTune *tune, guint subsong);
+static GstClockTime gst_sidplayfp_dec_get_position(GstSidplayfpDec *sidplayfp_dec);
+static guint gst_sidplayfp_dec_play_frames(GstSidplayfpDec *sidplayfp_dec, short *scratch_buffer, guint num_frames);
+static gboolean gst_sidplayfp_dec_fast_forward_to(GstSidplayfpDec *sidplayfp_dec, GstClockTime position);
+static void gst_sidplayfp_dec_start_probes(GstSidplayfpDec *sidplayfp_dec, GstBuffer *source_data, SidTune *tune);
+static void gst_sidplayfp_dec_stop_probes(GstSidplayfpDec *sidplayfp_dec, gboolean cancel);
+static gboolean gst_sidplayfp_dec_probes_cancelled(GstSidplayfpDec *sidplayfp_dec);
+static gpointer gst_sidplayfp_dec_probe_thread_func(gpointer data);
+static gint gst_sidplayfp_dec_probe_subsong_length(gst_sidplayfp_dec_probe_worker *worker, guint subsong);
+static gint gst_sidplayfp_dec_find_loop(guint8 const *fingerprints, guint num_blocks);
 static const gchar * gst_sidplayfp_dec_get_rom_name(GstSidplayfpDecRomIndex index);
 static unsigned int gst_sidplayfp_dec_to_sid_subsong_nr(SidTune *tune, guint subsong);
 
@@ -157,7 +203,6 @@ static inline const gchar * yesno_str(gboolean b)
 }
 
 // TODO: reset playback position when switching subsong during playback
-// TODO: is seeking somehow possible?
 
 
 
@@ -180,6 +225,9 @@ void gst_sidplayfp_dec_class_init(GstSidplayfpDecClass *klass)
 	object_class->set_property = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_set_property);
 	object_class->get_property = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_get_property);
 
+	element_class->change_state = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_change_state);
+
+	dec_class->seek                       = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_seek);
 	dec_class->tell                       = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_tell);
 	dec_class->load_from_buffer           = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_load_from_buffer);
 	dec_class->get_main_tags              = GST_DEBUG_FUNCPTR(gst_sidplayfp_dec_get_main_tags);
@@ -291,6 +339,17 @@ void gst_sidplayfp_dec_class_init(GstSidplayfpDecClass *klass)
 			GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_FAST_SAMPLING,
+		g_param_spec_boolean(
+			"fast-sampling",
+			"Fast sampling",
+			"Use faster, lower quality resampling in the SID emulation (takes effect when a tune is loaded)",
+			DEFAULT_FAST_SAMPLING,
+			GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
 	g_object_class_install_property(
 		object_class,
 		PROP_FALLBACK_SONG_LENGTH,
@@ -309,11 +368,22 @@ void gst_sidplayfp_dec_class_init(GstSidplayfpDecClass *klass)
 		g_param_spec_string(
 			"hsvc-songlength-db-path",
 			"HSVC song length database path",
-			"Full path to HSVD song length database (incl. filename); if NULL, no song length database is used",
+			"Full path to HSVD song length database (incl. filename; Songlengths.txt and Songlengths.md5 formats are supported); if NULL, no song length database is used",
 			DEFAULT_HSVC_SONGLENGTH_DB_PATH,
 			GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
 		)
 	);
+	g_object_class_install_property(
+		object_class,
+		PROP_PROBE_DURATIONS,
+		g_param_spec_boolean(
+			"probe-durations",
+			"Probe durations",
+			"Determine the length of subsongs which are not in the song length database by emulating them in the background until they end in silence or repeat (at most for fallback-song-length seconds)",
+			DEFAULT_PROBE_DURATIONS,
+			GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
+		)
+	);
 	g_object_class_install_property(
 		object_class,
 		PROP_OUTPUT_BUFFER_SIZE,
@@ -331,8 +401,8 @@ void gst_sidplayfp_dec_class_init(GstSidplayfpDecClass *klass)
 
 void gst_sidplayfp_dec_init(GstSidplayfpDec *sidplayfp_dec)
 {
-	new (&(sidplayfp_dec->engine)) sidplayfp();
-	new (&(sidplayfp_dec->builder)) ReSIDfpBuilder("gstsidplayfp-builder");
+	sidplayfp_dec->pooled_engine = NULL;
+	sidplayfp_dec->engine = NULL;
 	sidplayfp_dec->tune = NULL;
 
 	memset(sidplayfp_dec->rom_images, 0, sizeof(sidplayfp_dec->rom_images));
@@ -342,13 +412,31 @@ void gst_sidplayfp_dec_init(GstSidplayfpDec *sidplayfp_dec)
 	sidplayfp_dec->default_sid_model = DEFAULT_DEFAULT_SID_MODEL;
 	sidplayfp_dec->force_sid_model = DEFAULT_FORCE_SID_MODEL;
 	sidplayfp_dec->sampling_method = DEFAULT_SAMPLING_METHOD;
+	sidplayfp_dec->fast_sampling = DEFAULT_FAST_SAMPLING;
 
 	sidplayfp_dec->fallback_song_length = DEFAULT_FALLBACK_SONG_LENGTH;
 	sidplayfp_dec->hsvc_songlength_db_path = g_strdup(DEFAULT_HSVC_SONGLENGTH_DB_PATH);
 	// TODO: set path to $PREFIX/share/sidplayfp/Songlengths.txt
-	new (&(sidplayfp_dec->database)) SidDatabase();
+	sidplayfp_dec->songlength_db = NULL;
 	sidplayfp_dec->subsong_lengths = NULL;
 
+	sidplayfp_dec->probe_durations = DEFAULT_PROBE_DURATIONS;
+	g_mutex_init(&(sidplayfp_dec->subsong_lengths_lock));
+	sidplayfp_dec->probe_subsongs = NULL;
+	sidplayfp_dec->num_probe_subsongs = 0;
+	sidplayfp_dec->probe_max_length = 0;
+	sidplayfp_dec->probe_cache_key = NULL;
+	memset(&(sidplayfp_dec->probe_engine_config), 0, sizeof(sidplayfp_dec->probe_engine_config));
+	sidplayfp_dec->probe_workers = NULL;
+	sidplayfp_dec->num_probe_workers = 0;
+	sidplayfp_dec->next_probe_index = 0;
+	sidplayfp_dec->num_unprobed_subsongs = 0;
+	sidplayfp_dec->probes_cancelled = 0;
+
+	sidplayfp_dec->current_subsong = 0;
+	sidplayfp_dec->position_base = 0;
+	sidplayfp_dec->num_frames_since_base = 0;
+
 	sidplayfp_dec->sample_rate = DEFAULT_SAMPLE_RATE;
 	sidplayfp_dec->num_channels = DEFAULT_NUM_CHANNELS;
 
@@ -363,27 +451,97 @@ static void gst_sidplayfp_dec_finalize(GObject *object)
 	int i;
 	GstSidplayfpDec *sidplayfp_dec = GST_SIDPLAYFP_DEC(object);
 
+	gst_sidplayfp_dec_unload(sidplayfp_dec);
+	g_mutex_clear(&(sidplayfp_dec->subsong_lengths_lock));
+
 	for (i = 0; i < 3; ++i)
 	{
 		if (sidplayfp_dec->rom_images[i] != NULL)
 			gst_buffer_unref(sidplayfp_dec->rom_images[i]);
 	}
 
+	g_free(sidplayfp_dec->hsvc_songlength_db_path);
+
+	G_OBJECT_CLASS(gst_sidplayfp_dec_parent_class)->finalize(object);
+}
+
+
+static GstStateChangeReturn gst_sidplayfp_dec_change_state(GstElement *element, GstStateChange transition)
+{
+	GstNonstreamAudioDecoder *dec = GST_NONSTREAM_AUDIO_DECODER(element);
+	GstSidplayfpDec *sidplayfp_dec = GST_SIDPLAYFP_DEC(element);
+	GstStateChangeReturn ret;
+
+	ret = GST_ELEMENT_CLASS(gst_sidplayfp_dec_parent_class)->change_state(element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+		return ret;
+
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+			/* The base class flagged loading as cancelled, so the probe
+			 * threads stop at the next block; wait for them, and return
+			 * their engines to the pool. Subsongs that were not probed
+			 * yet use the fallback length. */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gst_sidplayfp_dec_stop_probes(sidplayfp_dec, TRUE);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		case GST_STATE_CHANGE_READY_TO_NULL:
+			/* The base class reset its state, so the next READY->PAUSED
+			 * state change loads new media; the engine goes back to the
+			 * pool until then */
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			gst_sidplayfp_dec_unload(sidplayfp_dec);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
+		default:
+			break;
+	}
+
+	return ret;
+}
+
+
+static void gst_sidplayfp_dec_unload(GstSidplayfpDec *sidplayfp_dec)
+{
+	/* Stop the probe threads before anything they use is freed */
+	gst_sidplayfp_dec_stop_probes(sidplayfp_dec, TRUE);
+	g_free(sidplayfp_dec->probe_subsongs);
+	sidplayfp_dec->probe_subsongs = NULL;
+	sidplayfp_dec->num_probe_subsongs = 0;
+	g_free(sidplayfp_dec->probe_cache_key);
+	sidplayfp_dec->probe_cache_key = NULL;
+
 	if (sidplayfp_dec->main_tags != NULL)
+	{
 		gst_tag_list_unref(sidplayfp_dec->main_tags);
+		sidplayfp_dec->main_tags = NULL;
+	}
 
-	sidplayfp_dec->database.~SidDatabase();
+	if (sidplayfp_dec->songlength_db != NULL)
+	{
+		gst_sidplayfp_songlength_db_unref(sidplayfp_dec->songlength_db);
+		sidplayfp_dec->songlength_db = NULL;
+	}
 	g_free(sidplayfp_dec->subsong_lengths);
+	sidplayfp_dec->subsong_lengths = NULL;
+
+	/* The engine must be released first, since it refers to the tune */
+	if (sidplayfp_dec->pooled_engine != NULL)
+	{
+		gst_sidplayfp_engine_pool_release(sidplayfp_dec->pooled_engine);
+		sidplayfp_dec->pooled_engine = NULL;
+		sidplayfp_dec->engine = NULL;
+	}
 
 	if (sidplayfp_dec->tune != NULL)
+	{
 		delete sidplayfp_dec->tune;
-
-	sidplayfp_dec->builder.~ReSIDfpBuilder();
-	sidplayfp_dec->engine.~sidplayfp();
-
-	g_free(sidplayfp_dec->hsvc_songlength_db_path);
-
-	G_OBJECT_CLASS(gst_sidplayfp_dec_parent_class)->finalize(object);
+		sidplayfp_dec->tune = NULL;
+	}
 }
 
 
@@ -461,6 +619,12 @@ static void gst_sidplayfp_dec_set_property(GObject *object, guint prop_id, const
 			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 			break;
 
+		case PROP_FAST_SAMPLING:
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			sidplayfp_dec->fast_sampling = g_value_get_boolean(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
 		case PROP_OUTPUT_BUFFER_SIZE:
 			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
 			sidplayfp_dec->output_buffer_size = g_value_get_uint(value);
@@ -480,6 +644,12 @@ static void gst_sidplayfp_dec_set_property(GObject *object, guint prop_id, const
 			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 			break;
 
+		case PROP_PROBE_DURATIONS:
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			sidplayfp_dec->probe_durations = g_value_get_boolean(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -535,6 +705,12 @@ static void gst_sidplayfp_dec_get_property(GObject *object, guint prop_id, GValu
 			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
 			break;
 
+		case PROP_FAST_SAMPLING:
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
+			g_value_set_boolean(value, sidplayfp_dec->fast_sampling);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			break;
+
 		case PROP_OUTPUT_BUFFER_SIZE:
 			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
 			g_value_set_uint(value, sidplayfp_dec->output_buffer_size);
@@ -553,6 +729,12 @@ static void gst_sidplayfp_dec_get_property(GObject *object, guint prop_id, GValu
 			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
 			break;
 
+		case PROP_PROBE_DURATIONS:
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(object);
+			g_value_set_boolean(value, sidplayfp_dec->probe_durations);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(object);
+			break;
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -560,19 +742,56 @@ static void gst_sidplayfp_dec_get_property(GObject *object, guint prop_id, GValu
 }
 
 
+static gboolean gst_sidplayfp_dec_seek(GstNonstreamAudioDecoder *dec, GstClockTime *new_position)
+{
+	GstSidplayfpDec *sidplayfp_dec = GST_SIDPLAYFP_DEC(dec);
+	GstClockTime position = *new_position;
+
+	g_return_val_if_fail(sidplayfp_dec->tune != NULL, FALSE);
+
+	/* sidplayfp cannot go back in time, and it has no way to save
+	 * and restore the emulation state. For seeking backwards, restart
+	 * the current subsong (loading it resets the C64), then fast-forward
+	 * from there. */
+	if (position < gst_sidplayfp_dec_get_position(sidplayfp_dec))
+	{
+		GST_DEBUG_OBJECT(sidplayfp_dec, "seeking backwards - restarting subsong");
+
+		if (!gst_sidplayfp_dec_start_subsong(sidplayfp_dec, sidplayfp_dec->tune, sidplayfp_dec->current_subsong))
+			return FALSE;
+	}
+
+	if (!gst_sidplayfp_dec_fast_forward_to(sidplayfp_dec, position))
+		return FALSE;
+
+	*new_position = gst_sidplayfp_dec_tell(dec);
+	GST_DEBUG_OBJECT(sidplayfp_dec, "position after seeking: %" GST_TIME_FORMAT, GST_TIME_ARGS(*new_position));
+
+	return TRUE;
+}
+
+
 static GstClockTime gst_sidplayfp_dec_tell(GstNonstreamAudioDecoder *dec)
 {
 	GstSidplayfpDec *sidplayfp_dec = GST_SIDPLAYFP_DEC(dec);
-	return sidplayfp_dec->engine.time() * GST_SECOND;
+
+	/* there is no engine in metadata-only mode */
+	if (sidplayfp_dec->engine == NULL)
+		return 0;
+
+	return gst_sidplayfp_dec_get_position(sidplayfp_dec);
 }
 
 
 static gboolean gst_sidplayfp_dec_load_from_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *source_data, guint initial_subsong, G_GNUC_UNUSED GstNonstreamAudioSubsongMode initial_subsong_mode, GstClockTime *initial_position, GstNonstreamAudioOutputMode *initial_output_mode, gint *initial_num_loops)
 {
 	GstSidplayfpDec *sidplayfp_dec = GST_SIDPLAYFP_DEC(dec);
-	guint max_num_sids;
 	GstMapInfo buffer_map;
-	unsigned int sid_subsong_nr;
+
+
+	/* After a READY->NULL->READY cycle, the base class loads again;
+	 * get rid of anything left over from an earlier load */
+	gst_sidplayfp_dec_unload(sidplayfp_dec);
 
 
 	/* Determine the sample rate and channel count to use */
@@ -594,101 +813,31 @@ static gboolean gst_sidplayfp_dec_load_from_buffer(GstNonstreamAudioDecoder *dec
 	/* Load the SID song length database if a path is set */
 	if (sidplayfp_dec->hsvc_songlength_db_path != NULL)
 	{
+		GError *error = NULL;
+
 		GST_DEBUG_OBJECT(sidplayfp_dec, "Attempting to read HSVC songlength database from \"%s\"", sidplayfp_dec->hsvc_songlength_db_path);
 
-		if (!(sidplayfp_dec->database.open(sidplayfp_dec->hsvc_songlength_db_path)))
+		/* The database index is shared with all other sidplayfpdec
+		 * instances; it is only parsed if no other instance did so
+		 * already, or if the file changed since then */
+		sidplayfp_dec->songlength_db = gst_sidplayfp_songlength_db_get(sidplayfp_dec->hsvc_songlength_db_path, &error);
+		if (sidplayfp_dec->songlength_db == NULL)
 		{
 			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
-			GST_ELEMENT_ERROR(sidplayfp_dec, RESOURCE, OPEN_READ, ("Could not open HSVC song length database"), ("error message: %s", sidplayfp_dec->database.error()));
+			GST_ELEMENT_ERROR(sidplayfp_dec, RESOURCE, OPEN_READ, ("Could not open HSVC song length database"), ("error message: %s", error->message));
 			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
 
-			return FALSE;
-		}
-	}
-
-
-	/* Set ROMs */
-	{
-		GstMapInfo rom_maps[3];
-		int i;
+			g_error_free(error);
 
-		memset(rom_maps, 0, sizeof(rom_maps));
-
-		for (i = 0; i < 3; ++i)
-		{
-			gchar const *rom_name = gst_sidplayfp_dec_get_rom_name(GstSidplayfpDecRomIndex(i));
-
-			if (sidplayfp_dec->rom_images[i] == NULL)
-				continue;
-
-			if (!gst_buffer_map(sidplayfp_dec->rom_images[i], &(rom_maps[i]), GST_MAP_READ))
-			{
-				int j;
-
-				GST_ERROR_OBJECT(sidplayfp_dec, "Could not map %s ROM", rom_name);
-
-				for (j = 0; j < i; ++j)
-				{
-					if (sidplayfp_dec->rom_images[j] != NULL)
-						gst_buffer_unmap(sidplayfp_dec->rom_images[j], &(rom_maps[j]));
-				}
-
-				return FALSE;
-			}
-
-			GST_DEBUG_OBJECT(sidplayfp_dec, "Using %s ROM with %" G_GSIZE_FORMAT " bytes", rom_name, rom_maps[i].size);
-		}
-
-		GST_DEBUG_OBJECT(
-			sidplayfp_dec,
-			"ROMs in use:  KERNAL: %s  BASIC: %s  character generator: %s",
-			yesno_str(rom_maps[GST_SIDPLAYFP_DEC_KERNAL_ROM].data != NULL),
-			yesno_str(rom_maps[GST_SIDPLAYFP_DEC_BASIC_ROM].data != NULL),
-			yesno_str(rom_maps[GST_SIDPLAYFP_DEC_CHARACTER_GEN_ROM].data != NULL)
-		);
-
-		sidplayfp_dec->engine.setRoms(
-			rom_maps[GST_SIDPLAYFP_DEC_KERNAL_ROM].data,
-			rom_maps[GST_SIDPLAYFP_DEC_BASIC_ROM].data,
-			rom_maps[GST_SIDPLAYFP_DEC_CHARACTER_GEN_ROM].data
-		);
-
-		for (i = 0; i < 3; ++i)
-		{
-			if (sidplayfp_dec->rom_images[i] != NULL)
-				gst_buffer_unmap(sidplayfp_dec->rom_images[i], &(rom_maps[i]));
+			return FALSE;
 		}
 	}
 
 
-	/* Create SIDs */
-	max_num_sids = sidplayfp_dec->engine.info().maxsids();
-	GST_DEBUG_OBJECT(sidplayfp_dec, "Max number of SIDs: %u", max_num_sids);
-	sidplayfp_dec->builder.create(max_num_sids);
-	if (!(sidplayfp_dec->builder.getStatus()))
-	{
-		GST_ERROR_OBJECT(sidplayfp_dec, "Could not create SIDs: %s", sidplayfp_dec->builder.error());
-		return FALSE;
-	}
-
-
-	/* Configure engine */
-	SidConfig cfg;
-	cfg.defaultC64Model = sidplayfp_dec->default_c64_model;
-	cfg.forceC64Model = sidplayfp_dec->force_c64_model;
-	cfg.defaultSidModel = sidplayfp_dec->default_sid_model;
-	cfg.forceSidModel = sidplayfp_dec->force_sid_model;
-	cfg.playback = (sidplayfp_dec->num_channels == 1) ? SidConfig::MONO : SidConfig::STEREO;
-	cfg.frequency = sidplayfp_dec->sample_rate;
-	cfg.sidEmulation = &(sidplayfp_dec->builder);
-	cfg.samplingMethod = sidplayfp_dec->sampling_method;
-	cfg.fastSampling = false;
-
-	if (!(sidplayfp_dec->engine.config(cfg)))
-	{
-		GST_ERROR_OBJECT(sidplayfp_dec, "Could not configure engine: %s", sidplayfp_dec->engine.error());
+	/* Set up ROMs, SIDs, and the engine configuration. None of this
+	 * is needed for reading metadata, so skip it in metadata-only mode. */
+	if (!(dec->metadata_only) && !gst_sidplayfp_dec_setup_engine(sidplayfp_dec))
 		return FALSE;
-	}
 
 
 	/* Load the SID file */
@@ -698,38 +847,46 @@ static gboolean gst_sidplayfp_dec_load_from_buffer(GstNonstreamAudioDecoder *dec
 #else
 	std::auto_ptr < SidTune > tune(new SidTune(buffer_map.data, buffer_map.size));
 #endif
-	gst_buffer_unmap(source_data, &buffer_map);
 
-	sid_subsong_nr = gst_sidplayfp_dec_to_sid_subsong_nr(tune.get(), initial_subsong);
-	sidplayfp_dec->current_subsong = initial_subsong;
-	tune->selectSong(sid_subsong_nr);
-
-	if (!(sidplayfp_dec->engine.load(tune.get())))
+	/* Songlengths.md5 databases are keyed by the MD5 of the entire file */
+	if ((sidplayfp_dec->songlength_db != NULL) && gst_sidplayfp_songlength_db_uses_full_file_md5(sidplayfp_dec->songlength_db))
 	{
-		GST_ERROR_OBJECT(sidplayfp_dec, "Could not load SID tune: %s", sidplayfp_dec->engine.error());
-		return FALSE;
+		gchar *md5 = g_compute_checksum_for_data(G_CHECKSUM_MD5, buffer_map.data, buffer_map.size);
+		g_strlcpy(sidplayfp_dec->md5, md5, sizeof(sidplayfp_dec->md5));
+		g_free(md5);
 	}
 
+	gst_buffer_unmap(source_data, &buffer_map);
 
-	/* Load HSVC database if available and retrieve subsong lengths from it */
-	if (sidplayfp_dec->hsvc_songlength_db_path != NULL)
+	if (!gst_sidplayfp_dec_start_subsong(sidplayfp_dec, tune.get(), initial_subsong))
+		return FALSE;
+
+
+	/* Retrieve subsong lengths from the HSVC database if available */
+	if (sidplayfp_dec->songlength_db != NULL)
 	{
 		guint i;
 		guint num_subsongs = tune->getInfo()->songs();
 
 		if (num_subsongs > 0)
 		{
-			/* Create MD5 for retrieving subsong lengths from the database */
-			tune->createMD5(sidplayfp_dec->md5);
+			/* Create MD5 for retrieving subsong lengths from the database
+			 * (unless the full file MD5 was already computed above) */
+			if (!gst_sidplayfp_songlength_db_uses_full_file_md5(sidplayfp_dec->songlength_db))
+				tune->createMD5(sidplayfp_dec->md5);
 
 			sidplayfp_dec->subsong_lengths = (int_least32_t *)g_malloc(sizeof(int_least32_t) * num_subsongs);
 
 			for (i = 0; i < num_subsongs; ++i)
 			{
 				unsigned int sid_subsong_nr = gst_sidplayfp_dec_to_sid_subsong_nr(tune.get(), i);
-				sidplayfp_dec->subsong_lengths[i] = sidplayfp_dec->database.length(sidplayfp_dec->md5, sid_subsong_nr);
+				gint length_ms = gst_sidplayfp_songlength_db_lookup(sidplayfp_dec->songlength_db, sidplayfp_dec->md5, sid_subsong_nr);
+
+				/* Subsong lengths are kept in seconds; round up, to not cut off the end */
+				sidplayfp_dec->subsong_lengths[i] = (length_ms < 0) ? -1 : ((length_ms + 999) / 1000);
+
 				if (sidplayfp_dec->subsong_lengths[i] < 0)
-					GST_ERROR_OBJECT(sidplayfp_dec, "Could not retrieve length from DB for subsong %u (%d): %s", i, gint(sid_subsong_nr), sidplayfp_dec->database.error());
+					GST_ERROR_OBJECT(sidplayfp_dec, "Could not retrieve length from DB for subsong %u (%d): MD5 %s not found", i, gint(sid_subsong_nr), sidplayfp_dec->md5);
 				else
 					GST_DEBUG_OBJECT(sidplayfp_dec, "Subsong %u (%u) / %u length: %d seconds", i, sid_subsong_nr, num_subsongs, gint(sidplayfp_dec->subsong_lengths[i]));
 			}
@@ -737,6 +894,24 @@ static gboolean gst_sidplayfp_dec_load_from_buffer(GstNonstreamAudioDecoder *dec
 	}
 
 
+	/* Probe the lengths of subsongs which the database does not know
+	 * in the background, so playback can begin immediately. In
+	 * metadata-only mode, there is no playback, and the durations are
+	 * needed before the TOC is produced, so wait for the probes. The
+	 * same goes for base classes that cannot be notified about updated
+	 * subsong information. */
+	if (sidplayfp_dec->probe_durations)
+	{
+		gst_sidplayfp_dec_start_probes(sidplayfp_dec, source_data, tune.get());
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+		if (dec->metadata_only)
+			gst_sidplayfp_dec_stop_probes(sidplayfp_dec, FALSE);
+#else
+		gst_sidplayfp_dec_stop_probes(sidplayfp_dec, FALSE);
+#endif
+	}
+
+
 	/* Get metadata and produce a tag list */
 	{
 		unsigned int num_info_strings = tune->getInfo()->numberOfInfoStrings();
@@ -761,15 +936,22 @@ static gboolean gst_sidplayfp_dec_load_from_buffer(GstNonstreamAudioDecoder *dec
 
 	/* Miscellaneous */
 
-	/* Seeking is not possible with sidplayfp */
-	if (*initial_position != 0)
+	sidplayfp_dec->num_loops = *initial_num_loops;
+
+	/* sidplayfp always starts at the beginning of the tune, so
+	 * fast-forward if playback shall start somewhere else */
+	if (!(dec->metadata_only) && (*initial_position != 0))
+	{
+		if (!gst_sidplayfp_dec_fast_forward_to(sidplayfp_dec, *initial_position))
+			return FALSE;
+		*initial_position = gst_sidplayfp_dec_tell(dec);
+	}
+	else
 		*initial_position = 0;
 
 	/* LOOPING output mode is not supported */
 	*initial_output_mode = GST_NONSTREM_AUDIO_OUTPUT_MODE_STEADY;
 
-	sidplayfp_dec->num_loops = *initial_num_loops;
-
 
 	/* Loading succeeded - release the tune pointer and store it */
 
@@ -786,12 +968,14 @@ static GstTagList* gst_sidplayfp_dec_get_main_tags(GstNonstreamAudioDecoder *dec
 }
 
 
-static gboolean gst_sidplayfp_dec_set_current_subsong(GstNonstreamAudioDecoder *dec, guint subsong, GstClockTime *)
+static gboolean gst_sidplayfp_dec_set_current_subsong(GstNonstreamAudioDecoder *dec, guint subsong, GstClockTime *initial_position)
 {
 	GstSidplayfpDec *sidplayfp_dec = GST_SIDPLAYFP_DEC(dec);
-	unsigned int sid_subsong_nr = gst_sidplayfp_dec_to_sid_subsong_nr(sidplayfp_dec->tune, subsong);
-	sidplayfp_dec->current_subsong = subsong;
-	sidplayfp_dec->tune->selectSong(sid_subsong_nr);
+
+	if (!gst_sidplayfp_dec_start_subsong(sidplayfp_dec, sidplayfp_dec->tune, subsong))
+		return FALSE;
+
+	*initial_position = 0;
 	return TRUE;
 }
 
@@ -814,7 +998,13 @@ static int_least32_t gst_sidplayfp_dec_get_subsong_duration_internal(GstSidplayf
 {
 	if (sidplayfp_dec->subsong_lengths != NULL)
 	{
-		int_least32_t len = sidplayfp_dec->subsong_lengths[subsong];
+		int_least32_t len;
+
+		/* probe threads might be writing to the array */
+		g_mutex_lock(&(sidplayfp_dec->subsong_lengths_lock));
+		len = sidplayfp_dec->subsong_lengths[subsong];
+		g_mutex_unlock(&(sidplayfp_dec->subsong_lengths_lock));
+
 		if (len == -1)
 			return sidplayfp_dec->fallback_song_length;
 		else
@@ -877,7 +1067,7 @@ static gboolean gst_sidplayfp_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffe
 	 */
 	if ((sidplayfp_dec->num_loops >= 0))
 	{
-		gint64 cur_time = sidplayfp_dec->engine.time();
+		gint64 cur_time = sidplayfp_dec->engine->time();
 		gint64 length = gst_sidplayfp_dec_get_subsong_duration_internal(sidplayfp_dec, sidplayfp_dec->current_subsong);
 
 		if (cur_time >= ((sidplayfp_dec->num_loops + 1) * length))
@@ -894,9 +1084,11 @@ static gboolean gst_sidplayfp_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffe
 
 	/* The actual decoding */
 	gst_buffer_map(outbuf, &map, GST_MAP_WRITE);
-	num_produced_samples = sidplayfp_dec->engine.play(reinterpret_cast < short* > (map.data), max_num_produced_samples);
+	num_produced_samples = sidplayfp_dec->engine->play(reinterpret_cast < short* > (map.data), max_num_produced_samples);
 	gst_buffer_unmap(outbuf, &map);
 
+	sidplayfp_dec->num_frames_since_base += num_produced_samples / sidplayfp_dec->num_channels;
+
 	*buffer = outbuf;
 	*num_samples = num_produced_samples / sidplayfp_dec->num_channels;
 
@@ -904,6 +1096,695 @@ static gboolean gst_sidplayfp_dec_decode(GstNonstreamAudioDecoder *dec, GstBuffe
 }
 
 
+static gboolean gst_sidplayfp_dec_setup_engine(GstSidplayfpDec *sidplayfp_dec)
+{
+	gst_sidplayfp_dec_engine_config config;
+
+	gst_sidplayfp_dec_init_engine_config(sidplayfp_dec, &config, sidplayfp_dec->sample_rate, sidplayfp_dec->num_channels, sidplayfp_dec->fast_sampling);
+	sidplayfp_dec->pooled_engine = gst_sidplayfp_dec_acquire_engine(sidplayfp_dec, &config);
+	gst_sidplayfp_dec_clear_engine_config(&config);
+
+	if (sidplayfp_dec->pooled_engine == NULL)
+		return FALSE;
+
+	sidplayfp_dec->engine = &(sidplayfp_dec->pooled_engine->engine);
+
+	return TRUE;
+}
+
+
+static void gst_sidplayfp_dec_init_engine_config(GstSidplayfpDec *sidplayfp_dec, gst_sidplayfp_dec_engine_config *config, gint sample_rate, gint num_channels, gboolean fast_sampling)
+{
+	/* must be called with lock */
+
+	int i;
+
+	for (i = 0; i < 3; ++i)
+		config->rom_images[i] = (sidplayfp_dec->rom_images[i] != NULL) ? gst_buffer_ref(sidplayfp_dec->rom_images[i]) : NULL;
+
+	config->default_c64_model = sidplayfp_dec->default_c64_model;
+	config->force_c64_model = sidplayfp_dec->force_c64_model;
+	config->default_sid_model = sidplayfp_dec->default_sid_model;
+	config->force_sid_model = sidplayfp_dec->force_sid_model;
+	config->sampling_method = sidplayfp_dec->sampling_method;
+	config->fast_sampling = fast_sampling;
+	config->sample_rate = sample_rate;
+	config->num_channels = num_channels;
+}
+
+
+static void gst_sidplayfp_dec_clear_engine_config(gst_sidplayfp_dec_engine_config *config)
+{
+	int i;
+
+	for (i = 0; i < 3; ++i)
+	{
+		if (config->rom_images[i] != NULL)
+			gst_buffer_unref(config->rom_images[i]);
+		config->rom_images[i] = NULL;
+	}
+}
+
+
+static GstSidplayfpPooledEngine* gst_sidplayfp_dec_acquire_engine(GstSidplayfpDec *sidplayfp_dec, gst_sidplayfp_dec_engine_config const *config)
+{
+	/* Only accesses the given configuration, not the decoder
+	 * properties, so it does not have to be called with lock */
+
+	GstSidplayfpPooledEngine *pooled_engine;
+	guint max_num_sids;
+	gchar *config_key;
+
+
+	/* Get an engine from the pool. If one with the same configuration
+	 * was used before, it is already fully set up, and the tune
+	 * just needs to be loaded into it. */
+	config_key = gst_sidplayfp_dec_get_engine_config_key(config);
+	pooled_engine = gst_sidplayfp_engine_pool_acquire(config_key);
+	g_free(config_key);
+
+	if (pooled_engine->configured)
+	{
+		GST_DEBUG_OBJECT(sidplayfp_dec, "reusing already configured engine from the pool");
+		return pooled_engine;
+	}
+
+	GST_DEBUG_OBJECT(sidplayfp_dec, "no configured engine available in the pool - setting up a new one");
+
+
+	/* Set ROMs */
+	{
+		GstMapInfo rom_maps[3];
+		int i;
+
+		memset(rom_maps, 0, sizeof(rom_maps));
+
+		for (i = 0; i < 3; ++i)
+		{
+			gchar const *rom_name = gst_sidplayfp_dec_get_rom_name(GstSidplayfpDecRomIndex(i));
+
+			if (config->rom_images[i] == NULL)
+				continue;
+
+			if (!gst_buffer_map(config->rom_images[i], &(rom_maps[i]), GST_MAP_READ))
+			{
+				int j;
+
+				GST_ERROR_OBJECT(sidplayfp_dec, "Could not map %s ROM", rom_name);
+
+				for (j = 0; j < i; ++j)
+				{
+					if (config->rom_images[j] != NULL)
+						gst_buffer_unmap(config->rom_images[j], &(rom_maps[j]));
+				}
+
+				gst_sidplayfp_engine_pool_release(pooled_engine);
+				return NULL;
+			}
+
+			GST_DEBUG_OBJECT(sidplayfp_dec, "Using %s ROM with %" G_GSIZE_FORMAT " bytes", rom_name, rom_maps[i].size);
+		}
+
+		GST_DEBUG_OBJECT(
+			sidplayfp_dec,
+			"ROMs in use:  KERNAL: %s  BASIC: %s  character generator: %s",
+			yesno_str(rom_maps[GST_SIDPLAYFP_DEC_KERNAL_ROM].data != NULL),
+			yesno_str(rom_maps[GST_SIDPLAYFP_DEC_BASIC_ROM].data != NULL),
+			yesno_str(rom_maps[GST_SIDPLAYFP_DEC_CHARACTER_GEN_ROM].data != NULL)
+		);
+
+		pooled_engine->engine.setRoms(
+			rom_maps[GST_SIDPLAYFP_DEC_KERNAL_ROM].data,
+			rom_maps[GST_SIDPLAYFP_DEC_BASIC_ROM].data,
+			rom_maps[GST_SIDPLAYFP_DEC_CHARACTER_GEN_ROM].data
+		);
+
+		for (i = 0; i < 3; ++i)
+		{
+			if (config->rom_images[i] != NULL)
+				gst_buffer_unmap(config->rom_images[i], &(rom_maps[i]));
+		}
+	}
+
+
+	/* Create SIDs */
+	max_num_sids = pooled_engine->engine.info().maxsids();
+	GST_DEBUG_OBJECT(sidplayfp_dec, "Max number of SIDs: %u", max_num_sids);
+	pooled_engine->builder.create(max_num_sids);
+	if (!(pooled_engine->builder.getStatus()))
+	{
+		GST_ERROR_OBJECT(sidplayfp_dec, "Could not create SIDs: %s", pooled_engine->builder.error());
+		gst_sidplayfp_engine_pool_release(pooled_engine);
+		return NULL;
+	}
+
+
+	/* Configure engine */
+	SidConfig cfg;
+	cfg.defaultC64Model = config->default_c64_model;
+	cfg.forceC64Model = config->force_c64_model;
+	cfg.defaultSidModel = config->default_sid_model;
+	cfg.forceSidModel = config->force_sid_model;
+	cfg.playback = (config->num_channels == 1) ? SidConfig::MONO : SidConfig::STEREO;
+	cfg.frequency = config->sample_rate;
+	cfg.sidEmulation = &(pooled_engine->builder);
+	cfg.samplingMethod = config->sampling_method;
+	cfg.fastSampling = config->fast_sampling;
+
+	if (!(pooled_engine->engine.config(cfg)))
+	{
+		GST_ERROR_OBJECT(sidplayfp_dec, "Could not configure engine: %s", pooled_engine->engine.error());
+		gst_sidplayfp_engine_pool_release(pooled_engine);
+		return NULL;
+	}
+
+	pooled_engine->configured = TRUE;
+
+	return pooled_engine;
+}
+
+
+static gchar* gst_sidplayfp_dec_get_engine_config_key(gst_sidplayfp_dec_engine_config const *config)
+{
+	/* Describes everything that goes into acquire_engine(). The ROMs are
+	 * identified by their contents, since setRoms() copies them into
+	 * the engine's memory. */
+
+	gchar *rom_checksums[3];
+	gchar *config_key;
+	int i;
+
+	for (i = 0; i < 3; ++i)
+	{
+		GstMapInfo rom_map;
+
+		rom_checksums[i] = NULL;
+
+		if ((config->rom_images[i] == NULL) || !gst_buffer_map(config->rom_images[i], &rom_map, GST_MAP_READ))
+			continue;
+
+		rom_checksums[i] = g_compute_checksum_for_data(G_CHECKSUM_MD5, rom_map.data, rom_map.size);
+		gst_buffer_unmap(config->rom_images[i], &rom_map);
+	}
+
+	config_key = g_strdup_printf(
+		"c64model=%d:%d sidmodel=%d:%d sampling=%d:%d rate=%d channels=%d kernal=%s basic=%s chargen=%s",
+		int(config->default_c64_model), config->force_c64_model,
+		int(config->default_sid_model), config->force_sid_model,
+		int(config->sampling_method), config->fast_sampling,
+		config->sample_rate,
+		config->num_channels,
+		GST_STR_NULL(rom_checksums[GST_SIDPLAYFP_DEC_KERNAL_ROM]),
+		GST_STR_NULL(rom_checksums[GST_SIDPLAYFP_DEC_BASIC_ROM]),
+		GST_STR_NULL(rom_checksums[GST_SIDPLAYFP_DEC_CHARACTER_GEN_ROM])
+	);
+
+	for (i = 0; i < 3; ++i)
+		g_free(rom_checksums[i]);
+
+	return config_key;
+}
+
+
+static gboolean gst_sidplayfp_dec_start_subsong(GstSidplayfpDec *sidplayfp_dec, SidTune *tune, guint subsong)
+{
+	/* Selects the subsong in the tune, and (re)loads the tune into the
+	 * engine, which resets the C64 and starts the subsong from the
+	 * beginning. Selecting a subsong alone does not affect the engine,
+	 * so subsong switches and backwards seeks both go through here,
+	 * otherwise the engine could end up playing a different subsong
+	 * than the one that is selected in the tune. In metadata-only mode,
+	 * there is no engine, and only the selection is done. */
+
+	sidplayfp_dec->current_subsong = subsong;
+	sidplayfp_dec->position_base = 0;
+	sidplayfp_dec->num_frames_since_base = 0;
+	tune->selectSong(gst_sidplayfp_dec_to_sid_subsong_nr(tune, subsong));
+
+	if ((sidplayfp_dec->engine != NULL) && !(sidplayfp_dec->engine->load(tune)))
+	{
+		GST_ERROR_OBJECT(sidplayfp_dec, "Could not load SID tune: %s", sidplayfp_dec->engine->error());
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+static GstClockTime gst_sidplayfp_dec_get_position(GstSidplayfpDec *sidplayfp_dec)
+{
+	return sidplayfp_dec->position_base + gst_util_uint64_scale_int(sidplayfp_dec->num_frames_since_base, GST_SECOND, sidplayfp_dec->sample_rate);
+}
+
+
+static guint gst_sidplayfp_dec_play_frames(GstSidplayfpDec *sidplayfp_dec, short *scratch_buffer, guint num_frames)
+{
+	/* Emulates and discards num_frames frames; returns the number of
+	 * frames that were actually produced (0 in case of an error) */
+
+	uint_least32_t num_samples = sidplayfp_dec->engine->play(scratch_buffer, num_frames * sidplayfp_dec->num_channels);
+
+	if (num_samples == 0)
+		GST_ERROR_OBJECT(sidplayfp_dec, "Error while fast-forwarding: %s", sidplayfp_dec->engine->error());
+
+	return num_samples / sidplayfp_dec->num_channels;
+}
+
+
+static gboolean gst_sidplayfp_dec_fast_forward_to(GstSidplayfpDec *sidplayfp_dec, GstClockTime position)
+{
+	short *scratch_buffer;
+	guint chunk_size, target_second;
+	guint64 num_remaining_frames;
+	gboolean ret = FALSE;
+
+	/* There is no point in emulating beyond the end of playback,
+	 * since decode() stops once this point is reached */
+	if (sidplayfp_dec->num_loops >= 0)
+	{
+		guint length = gst_sidplayfp_dec_get_subsong_duration_internal(sidplayfp_dec, sidplayfp_dec->current_subsong);
+		position = MIN(position, guint64(sidplayfp_dec->num_loops + 1) * length * GST_SECOND);
+	}
+
+	if (gst_sidplayfp_dec_get_position(sidplayfp_dec) >= position)
+		return TRUE;
+
+	chunk_size = sidplayfp_dec->output_buffer_size;
+	scratch_buffer = g_new(short, chunk_size * sidplayfp_dec->num_channels);
+	target_second = position / GST_SECOND;
+
+	if (sidplayfp_dec->engine->time() < target_second)
+	{
+		/* In fast-forward mode, the emulation runs at the given speed,
+		 * and the mixer only produces one out of every (percent/100)
+		 * samples, so the output can be discarded cheaply. Each chunk
+		 * covers a lot of emulated time, and sidplayfp only reports whole
+		 * seconds, so fast-forwarding stops within the second before the
+		 * target second. */
+		if ((sidplayfp_dec->engine->time() + 1) < target_second)
+		{
+			if (!(sidplayfp_dec->engine->fastForward(SEEK_FAST_FORWARD_PERCENT)))
+				GST_WARNING_OBJECT(sidplayfp_dec, "Could not enable fast-forward mode; seeking will be slow");
+
+			while ((sidplayfp_dec->engine->time() + 1) < target_second)
+			{
+				if (!gst_sidplayfp_dec_play_frames(sidplayfp_dec, scratch_buffer, chunk_size))
+					break;
+			}
+
+			sidplayfp_dec->engine->fastForward(100);
+
+			if ((sidplayfp_dec->engine->time() + 1) < target_second)
+				goto finish;
+		}
+
+		/* Emulate the rest of that second in small chunks at normal
+		 * speed, to find the point where the target second begins */
+		while (sidplayfp_dec->engine->time() < target_second)
+		{
+			if (!gst_sidplayfp_dec_play_frames(sidplayfp_dec, scratch_buffer, CLAMP(guint(sidplayfp_dec->sample_rate / SEEK_CHUNKS_PER_SECOND), 1u, chunk_size)))
+				goto finish;
+		}
+
+		sidplayfp_dec->position_base = GstClockTime(target_second) * GST_SECOND;
+		sidplayfp_dec->num_frames_since_base = 0;
+	}
+
+	/* The exact position is known now; emulate up to the target */
+	num_remaining_frames = gst_util_uint64_scale_int(position - gst_sidplayfp_dec_get_position(sidplayfp_dec), sidplayfp_dec->sample_rate, GST_SECOND);
+	while (num_remaining_frames > 0)
+	{
+		guint num_frames = gst_sidplayfp_dec_play_frames(sidplayfp_dec, scratch_buffer, MIN(num_remaining_frames, guint64(chunk_size)));
+
+		if (num_frames == 0)
+			goto finish;
+
+		sidplayfp_dec->num_frames_since_base += num_frames;
+		num_remaining_frames -= MIN(num_remaining_frames, guint64(num_frames));
+	}
+
+	ret = TRUE;
+
+finish:
+	g_free(scratch_buffer);
+	return ret;
+}
+
+
+static void gst_sidplayfp_dec_start_probes(GstSidplayfpDec *sidplayfp_dec, GstBuffer *source_data, SidTune *tune)
+{
+	/* must be called with lock */
+
+	GstMapInfo buffer_map;
+	char md5[SidTune::MD5_LENGTH + 1];
+	gint const *cached_lengths;
+	guint num_subsongs, num_workers, i;
+
+	num_subsongs = tune->getInfo()->songs();
+	if (num_subsongs == 0)
+		return;
+
+	if (sidplayfp_dec->subsong_lengths == NULL)
+	{
+		sidplayfp_dec->subsong_lengths = (int_least32_t *)g_malloc(sizeof(int_least32_t) * num_subsongs);
+		for (i = 0; i < num_subsongs; ++i)
+			sidplayfp_dec->subsong_lengths[i] = -1;
+	}
+
+	sidplayfp_dec->probe_subsongs = g_new(guint, num_subsongs);
+	sidplayfp_dec->num_probe_subsongs = 0;
+	for (i = 0; i < num_subsongs; ++i)
+	{
+		if (sidplayfp_dec->subsong_lengths[i] < 0)
+			sidplayfp_dec->probe_subsongs[sidplayfp_dec->num_probe_subsongs++] = i;
+	}
+
+	if (sidplayfp_dec->num_probe_subsongs == 0)
+		return;
+
+	/* Probe results only depend on the tune and on how long
+	 * it is emulated, so they are cached by MD5 and length limit */
+	tune->createMD5(md5);
+	sidplayfp_dec->probe_max_length = sidplayfp_dec->fallback_song_length;
+	sidplayfp_dec->probe_cache_key = g_strdup_printf("%s:%u", md5, sidplayfp_dec->probe_max_length);
+
+	G_LOCK(probe_cache);
+	cached_lengths = (probe_cache != NULL) ? (gint const *)g_hash_table_lookup(probe_cache, sidplayfp_dec->probe_cache_key) : NULL;
+	if (cached_lengths != NULL)
+	{
+		for (i = 0; i < sidplayfp_dec->num_probe_subsongs; ++i)
+		{
+			guint subsong = sidplayfp_dec->probe_subsongs[i];
+			sidplayfp_dec->subsong_lengths[subsong] = cached_lengths[subsong];
+		}
+	}
+	G_UNLOCK(probe_cache);
+
+	if (cached_lengths != NULL)
+	{
+		GST_DEBUG_OBJECT(sidplayfp_dec, "using cached probed subsong lengths");
+		sidplayfp_dec->num_probe_subsongs = 0;
+		return;
+	}
+
+	/* Each thread needs its own engine, which is expensive to set up
+	 * (unless the pool has one), so the thread count is limited further.
+	 * The threads set up their engines themselves, out of a snapshot of
+	 * the configuration, so playback does not have to wait for that. */
+	num_workers = MIN(MIN(sidplayfp_dec->num_probe_subsongs, g_get_num_processors()), MAX_PROBE_THREADS);
+
+	sidplayfp_dec->next_probe_index = 0;
+	sidplayfp_dec->num_unprobed_subsongs = sidplayfp_dec->num_probe_subsongs;
+	sidplayfp_dec->probes_cancelled = 0;
+	sidplayfp_dec->probe_workers = g_new0(gst_sidplayfp_dec_probe_worker, num_workers);
+	sidplayfp_dec->num_probe_workers = num_workers;
+
+	/* The probe output is only analyzed, never played, so
+	 * low quality mono output at a low rate is sufficient */
+	gst_sidplayfp_dec_init_engine_config(sidplayfp_dec, &(sidplayfp_dec->probe_engine_config), PROBE_SAMPLE_RATE, 1, TRUE);
+
+	gst_buffer_map(source_data, &buffer_map, GST_MAP_READ);
+
+	for (i = 0; i < num_workers; ++i)
+	{
+		gst_sidplayfp_dec_probe_worker *worker = &(sidplayfp_dec->probe_workers[i]);
+
+		worker->sidplayfp_dec = sidplayfp_dec;
+		worker->pooled_engine = NULL;
+		worker->tune = new SidTune(buffer_map.data, buffer_map.size);
+	}
+
+	gst_buffer_unmap(source_data, &buffer_map);
+
+	for (i = 0; i < sidplayfp_dec->num_probe_workers; ++i)
+	{
+		gst_sidplayfp_dec_probe_worker *worker = &(sidplayfp_dec->probe_workers[i]);
+		GError *error = NULL;
+
+		worker->thread = g_thread_try_new("sidplayfpdec-probe", gst_sidplayfp_dec_probe_thread_func, worker, &error);
+		if (worker->thread == NULL)
+		{
+			GST_WARNING_OBJECT(sidplayfp_dec, "could not create duration probe thread: %s", error->message);
+			g_error_free(error);
+		}
+	}
+
+	GST_DEBUG_OBJECT(sidplayfp_dec, "probing durations of %u subsong(s) with %u thread(s)", sidplayfp_dec->num_probe_subsongs, sidplayfp_dec->num_probe_workers);
+
+	/* If no thread could be created, do the work right here */
+	if ((sidplayfp_dec->num_probe_workers > 0) && (sidplayfp_dec->probe_workers[0].thread == NULL))
+		gst_sidplayfp_dec_probe_thread_func(&(sidplayfp_dec->probe_workers[0]));
+}
+
+
+static void gst_sidplayfp_dec_stop_probes(GstSidplayfpDec *sidplayfp_dec, gboolean cancel)
+{
+	guint i;
+
+	if (cancel)
+		g_atomic_int_set(&(sidplayfp_dec->probes_cancelled), 1);
+
+	for (i = 0; i < sidplayfp_dec->num_probe_workers; ++i)
+	{
+		gst_sidplayfp_dec_probe_worker *worker = &(sidplayfp_dec->probe_workers[i]);
+
+		if (worker->thread != NULL)
+			g_thread_join(worker->thread);
+
+		/* release the engine first, since it refers to the tune */
+		if (worker->pooled_engine != NULL)
+			gst_sidplayfp_engine_pool_release(worker->pooled_engine);
+		delete worker->tune;
+	}
+
+	g_free(sidplayfp_dec->probe_workers);
+	sidplayfp_dec->probe_workers = NULL;
+	sidplayfp_dec->num_probe_workers = 0;
+
+	gst_sidplayfp_dec_clear_engine_config(&(sidplayfp_dec->probe_engine_config));
+}
+
+
+static gboolean gst_sidplayfp_dec_probes_cancelled(GstSidplayfpDec *sidplayfp_dec)
+{
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	if (gst_nonstream_audio_decoder_is_loading_cancelled(GST_NONSTREAM_AUDIO_DECODER(sidplayfp_dec)))
+		return TRUE;
+#endif
+	return g_atomic_int_get(&(sidplayfp_dec->probes_cancelled));
+}
+
+
+static gpointer gst_sidplayfp_dec_probe_thread_func(gpointer data)
+{
+	gst_sidplayfp_dec_probe_worker *worker = (gst_sidplayfp_dec_probe_worker *)data;
+	GstSidplayfpDec *sidplayfp_dec = worker->sidplayfp_dec;
+
+	/* probe_engine_config stays unchanged while the probe threads run */
+	worker->pooled_engine = gst_sidplayfp_dec_acquire_engine(sidplayfp_dec, &(sidplayfp_dec->probe_engine_config));
+	if (worker->pooled_engine == NULL)
+	{
+		GST_WARNING_OBJECT(sidplayfp_dec, "could not set up engine for duration probing");
+		return NULL;
+	}
+
+	while (TRUE)
+	{
+		guint index, subsong;
+		gint length;
+
+		index = (guint)g_atomic_int_add(&(sidplayfp_dec->next_probe_index), 1);
+		if (index >= sidplayfp_dec->num_probe_subsongs)
+			break;
+
+		subsong = sidplayfp_dec->probe_subsongs[index];
+		length = gst_sidplayfp_dec_probe_subsong_length(worker, subsong);
+
+		if (gst_sidplayfp_dec_probes_cancelled(sidplayfp_dec))
+		{
+			GST_DEBUG_OBJECT(sidplayfp_dec, "duration probe thread was cancelled");
+			break;
+		}
+
+		if (length >= 0)
+		{
+			GST_DEBUG_OBJECT(sidplayfp_dec, "subsong %u: probed length %d seconds", subsong, length);
+
+			g_mutex_lock(&(sidplayfp_dec->subsong_lengths_lock));
+			sidplayfp_dec->subsong_lengths[subsong] = length;
+			g_mutex_unlock(&(sidplayfp_dec->subsong_lengths_lock));
+
+#ifdef HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+			gst_nonstream_audio_decoder_subsong_info_changed(GST_NONSTREAM_AUDIO_DECODER(sidplayfp_dec));
+#endif
+		}
+		else
+			GST_DEBUG_OBJECT(sidplayfp_dec, "subsong %u: could not determine length - using fallback length", subsong);
+
+		/* the thread which probed the last subsong puts the results in the cache */
+		if (g_atomic_int_dec_and_test(&(sidplayfp_dec->num_unprobed_subsongs)))
+		{
+			guint num_subsongs = worker->tune->getInfo()->songs();
+			gint *lengths = g_new(gint, num_subsongs);
+			guint i;
+
+			g_mutex_lock(&(sidplayfp_dec->subsong_lengths_lock));
+			for (i = 0; i < num_subsongs; ++i)
+				lengths[i] = sidplayfp_dec->subsong_lengths[i];
+			g_mutex_unlock(&(sidplayfp_dec->subsong_lengths_lock));
+
+			G_LOCK(probe_cache);
+			if (probe_cache == NULL)
+				probe_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+			if (g_hash_table_size(probe_cache) >= MAX_PROBE_CACHE_ENTRIES)
+				g_hash_table_remove_all(probe_cache);
+			g_hash_table_replace(probe_cache, g_strdup(sidplayfp_dec->probe_cache_key), lengths);
+			G_UNLOCK(probe_cache);
+		}
+	}
+
+	return NULL;
+}
+
+
+static gint gst_sidplayfp_dec_probe_subsong_length(gst_sidplayfp_dec_probe_worker *worker, guint subsong)
+{
+	/* Returns the length in seconds, or -1 if it could not be determined.
+	 *
+	 * The output is analyzed in blocks. The end of the subsong is found
+	 * either by silence after audible output, or by repetition: each block
+	 * gets a coarse fingerprint (its power on a log2 scale), which is used
+	 * by gst_sidplayfp_dec_find_loop() to detect that the tune started
+	 * over. */
+
+	GstSidplayfpDec *sidplayfp_dec = worker->sidplayfp_dec;
+	sidplayfp *engine = &(worker->pooled_engine->engine);
+	short samples[PROBE_BLOCK_SIZE];
+	guint8 *fingerprints;
+	guint max_num_blocks, num_blocks, num_silent_blocks;
+	gint length_in_blocks = -1;
+	gboolean heard_audio = FALSE;
+
+	worker->tune->selectSong(gst_sidplayfp_dec_to_sid_subsong_nr(worker->tune, subsong));
+	if (!(engine->load(worker->tune)))
+	{
+		GST_WARNING_OBJECT(sidplayfp_dec, "could not load tune for duration probing: %s", engine->error());
+		return -1;
+	}
+
+	max_num_blocks = sidplayfp_dec->probe_max_length * PROBE_BLOCKS_PER_SECOND;
+	fingerprints = g_new(guint8, max_num_blocks);
+	num_silent_blocks = 0;
+
+	for (num_blocks = 0; (num_blocks < max_num_blocks) && (length_in_blocks < 0); ++num_blocks)
+	{
+		uint_least32_t num_samples, i;
+		gint64 sum, mean;
+		guint64 sum_of_squares;
+		gint64 peak;
+
+		if (gst_sidplayfp_dec_probes_cancelled(sidplayfp_dec))
+			break;
+
+		num_samples = engine->play(samples, PROBE_BLOCK_SIZE);
+		if (num_samples == 0)
+		{
+			GST_WARNING_OBJECT(sidplayfp_dec, "error while probing duration: %s", engine->error());
+			break;
+		}
+
+		/* the SID output can have a DC offset, so only the AC part counts */
+		sum = 0;
+		for (i = 0; i < num_samples; ++i)
+			sum += samples[i];
+		mean = sum / gint64(num_samples);
+
+		peak = 0;
+		sum_of_squares = 0;
+		for (i = 0; i < num_samples; ++i)
+		{
+			gint64 ac = samples[i] - mean;
+			peak = MAX(peak, ABS(ac));
+			sum_of_squares += ac * ac;
+		}
+
+		fingerprints[num_blocks] = g_bit_storage(sum_of_squares / num_samples);
+
+		/* Silence detection */
+		if (peak < PROBE_SILENCE_THRESHOLD)
+		{
+			if (heard_audio && (++num_silent_blocks >= PROBE_SILENCE_BLOCKS))
+				length_in_blocks = num_blocks + 1 - num_silent_blocks;
+		}
+		else
+		{
+			heard_audio = TRUE;
+			num_silent_blocks = 0;
+		}
+
+		/* Repetition detection; done once per second, since the
+		 * number of candidate periods grows with the emulated length */
+		if ((length_in_blocks < 0) && heard_audio && (((num_blocks + 1) % PROBE_BLOCKS_PER_SECOND) == 0))
+			length_in_blocks = gst_sidplayfp_dec_find_loop(fingerprints, num_blocks + 1);
+	}
+
+	g_free(fingerprints);
+
+	if (length_in_blocks < 0)
+		return -1;
+
+	/* round up, to not cut off the end */
+	return MAX((length_in_blocks + PROBE_BLOCKS_PER_SECOND - 1) / PROBE_BLOCKS_PER_SECOND, 1);
+}
+
+
+static gint gst_sidplayfp_dec_find_loop(guint8 const *fingerprints, guint num_blocks)
+{
+	/* Returns the length in blocks up to the point where the tune
+	 * starts over, or -1 if no repetition was found.
+	 *
+	 * A period is only accepted once the last period's worth of blocks
+	 * matches the period right before it in full. Matching just a fixed
+	 * number of blocks is not enough, since then any repeated verse or
+	 * chorus that is longer than that would be taken for the loop, and
+	 * the tune would be cut at its second occurrence. */
+
+	guint period;
+
+	for (period = PROBE_MIN_LOOP_BLOCKS; (period * 2) <= num_blocks; ++period)
+	{
+		guint8 const *window = fingerprints + num_blocks - period;
+		guint8 const *previous = window - period;
+		guint8 min_fp = G_MAXUINT8, max_fp = 0;
+		guint j, loop_start;
+
+		for (j = 0; j < period; ++j)
+		{
+			if (ABS(gint(previous[j]) - gint(window[j])) > 1)
+				break;
+			min_fp = MIN(min_fp, window[j]);
+			max_fp = MAX(max_fp, window[j]);
+		}
+
+		/* Sequences with nearly constant power match
+		 * almost anything, so they are not considered */
+		if ((j < period) || (max_fp - min_fp < PROBE_MIN_FINGERPRINT_RANGE))
+			continue;
+
+		/* The repetition might have begun before the last two periods
+		 * (the detection only runs once per second); find where */
+		loop_start = num_blocks - period * 2;
+		while ((loop_start > 0) && (ABS(gint(fingerprints[loop_start - 1]) - gint(fingerprints[loop_start - 1 + period])) <= 1))
+			--loop_start;
+
+		/* what starts at loop_start + period is a repetition of what started at loop_start */
+		return loop_start + period;
+	}
+
+	return -1;
+}
+
+
 static const gchar * gst_sidplayfp_dec_get_rom_name(GstSidplayfpDecRomIndex index)
 {
 	switch (index)
@@ -4,11 +4,12 @@
 
 #include <gst/gst.h>
 #include "gst/audio/gstnonstreamaudiodecoder.h"
+#include "gstsidplayfpsonglengthdb.h"
+#include "gstsidplayfpenginepool.h"
 #include <string>
 #include <sidplayfp/sidplayfp.h>
 #include <sidplayfp/SidTune.h>
 #include <sidplayfp/SidConfig.h>
-#include <sidplayfp/SidDatabase.h>
 #include <sidplayfp/builders/residfp.h>
 
 
@@ -35,12 +36,45 @@ typedef enum
 GstSidplayfpDecRomIndex;
 
 
+/* Everything that goes into the configuration of an engine. This is a
+ * snapshot of the decoder properties, so that engines can be set up
+ * without holding the decoder lock (the ROM buffers are referenced). */
+typedef struct
+{
+	GstBuffer *rom_images[3];
+	SidConfig::c64_model_t default_c64_model;
+	gboolean force_c64_model;
+	SidConfig::sid_model_t default_sid_model;
+	gboolean force_sid_model;
+	SidConfig::sampling_method_t sampling_method;
+	gboolean fast_sampling;
+	gint sample_rate, num_channels;
+}
+gst_sidplayfp_dec_engine_config;
+
+
+typedef struct
+{
+	GstSidplayfpDec *sidplayfp_dec;
+	/* each probe thread has its own engine and tune instance; the
+	 * engine is acquired by the thread itself (using the decoder's
+	 * probe_engine_config), since setting it up can be expensive */
+	GstSidplayfpPooledEngine *pooled_engine;
+	SidTune *tune;
+	GThread *thread;
+}
+gst_sidplayfp_dec_probe_worker;
+
+
 struct _GstSidplayfpDec
 {
 	GstNonstreamAudioDecoder parent;
 
-	sidplayfp engine;
-	ReSIDfpBuilder builder;
+	/* The engine and its builder come from the engine pool (see
+	 * gstsidplayfpenginepool.h); engine points to pooled_engine->engine .
+	 * Both are NULL in metadata-only mode. */
+	GstSidplayfpPooledEngine *pooled_engine;
+	sidplayfp *engine;
 	SidTune *tune;
 	char md5[SidTune::MD5_LENGTH + 1];
 
@@ -51,14 +85,42 @@ struct _GstSidplayfpDec
 	SidConfig::sid_model_t default_sid_model;
 	gboolean force_sid_model;
 	SidConfig::sampling_method_t sampling_method;
+	gboolean fast_sampling;
 
 	guint fallback_song_length;
 	gchar *hsvc_songlength_db_path;
-	SidDatabase database;
+	GstSidplayfpSonglengthDb *songlength_db;
 	int_least32_t *subsong_lengths;
 
+	/* Duration probing: subsongs without a length in the database are
+	 * emulated in background threads, until they end in silence or start
+	 * to repeat (or until fallback_song_length is reached). While these
+	 * threads run, subsong_lengths is protected by subsong_lengths_lock.
+	 * If both this lock and the decoder mutex are taken, the decoder
+	 * mutex must be taken first. */
+	gboolean probe_durations;
+	GMutex subsong_lengths_lock;
+	guint *probe_subsongs;
+	guint num_probe_subsongs;
+	guint probe_max_length;
+	gchar *probe_cache_key;
+	gst_sidplayfp_dec_engine_config probe_engine_config;
+	gst_sidplayfp_dec_probe_worker *probe_workers;
+	guint num_probe_workers;
+	volatile gint next_probe_index;
+	volatile gint num_unprobed_subsongs;
+	volatile gint probes_cancelled;
+
 	unsigned int current_subsong;
 
+	/* sidplayfp only reports the playback position in whole seconds, so
+	 * the exact position is tracked here: it is position_base plus the
+	 * duration of num_frames_since_base frames. position_base is set
+	 * whenever the position is known exactly (when a subsong is started,
+	 * and when fast_forward_to() crosses a second boundary). */
+	GstClockTime position_base;
+	guint64 num_frames_since_base;
+
 	gint sample_rate, num_channels;
 
 	gint num_loops;
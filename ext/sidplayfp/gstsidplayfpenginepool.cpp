@@ -0,0 +1,113 @@
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include "gstsidplayfpenginepool.h"
+
+
+/* Maximum number of idle engines kept per configuration. Each idle
+ * engine holds on to its SIDs and its C64 memory, so unused engines
+ * beyond this number are destroyed. */
+#define MAX_IDLE_ENGINES_PER_CONFIG 4
+
+
+/* config key -> GQueue of idle GstSidplayfpPooledEngine instances */
+G_LOCK_DEFINE_STATIC(engine_pool);
+static GHashTable *engine_pool = NULL;
+
+
+static void gst_sidplayfp_engine_pool_free_queue(gpointer data);
+
+
+
+GstSidplayfpPooledEngine::GstSidplayfpPooledEngine(gchar const *config_key)
+	: builder("gstsidplayfp-builder")
+	, config_key(g_strdup(config_key))
+	, configured(FALSE)
+{
+}
+
+
+GstSidplayfpPooledEngine::~GstSidplayfpPooledEngine()
+{
+	g_free(config_key);
+}
+
+
+GstSidplayfpPooledEngine* gst_sidplayfp_engine_pool_acquire(gchar const *config_key)
+{
+	GstSidplayfpPooledEngine *pooled_engine = NULL;
+
+	g_return_val_if_fail(config_key != NULL, NULL);
+
+	G_LOCK(engine_pool);
+
+	if (engine_pool != NULL)
+	{
+		GQueue *idle_engines = (GQueue *)g_hash_table_lookup(engine_pool, config_key);
+		if (idle_engines != NULL)
+			pooled_engine = (GstSidplayfpPooledEngine *)g_queue_pop_head(idle_engines);
+	}
+
+	G_UNLOCK(engine_pool);
+
+	if (pooled_engine == NULL)
+		pooled_engine = new GstSidplayfpPooledEngine(config_key);
+
+	return pooled_engine;
+}
+
+
+void gst_sidplayfp_engine_pool_release(GstSidplayfpPooledEngine *pooled_engine)
+{
+	GQueue *idle_engines;
+
+	g_return_if_fail(pooled_engine != NULL);
+
+	/* Partially configured engines cannot be reused */
+	if (!(pooled_engine->configured))
+	{
+		delete pooled_engine;
+		return;
+	}
+
+	/* The engine refers to the tune, which is owned by the decoder,
+	 * and is about to be deleted; load(NULL) stops playback and
+	 * unloads the tune */
+	pooled_engine->engine.load(NULL);
+
+	G_LOCK(engine_pool);
+
+	if (engine_pool == NULL)
+		engine_pool = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, gst_sidplayfp_engine_pool_free_queue);
+
+	idle_engines = (GQueue *)g_hash_table_lookup(engine_pool, pooled_engine->config_key);
+	if (idle_engines == NULL)
+	{
+		idle_engines = g_queue_new();
+		g_hash_table_insert(engine_pool, g_strdup(pooled_engine->config_key), idle_engines);
+	}
+
+	if (g_queue_get_length(idle_engines) < MAX_IDLE_ENGINES_PER_CONFIG)
+	{
+		g_queue_push_head(idle_engines, pooled_engine);
+		pooled_engine = NULL;
+	}
+
+	G_UNLOCK(engine_pool);
+
+	/* The pool is full for this configuration */
+	delete pooled_engine;
+}
+
+
+static void gst_sidplayfp_engine_pool_free_queue(gpointer data)
+{
+	GQueue *idle_engines = (GQueue *)data;
+	GstSidplayfpPooledEngine *pooled_engine;
+
+	while ((pooled_engine = (GstSidplayfpPooledEngine *)g_queue_pop_head(idle_engines)) != NULL)
+		delete pooled_engine;
+
+	g_queue_free(idle_engines);
+}
@@ -0,0 +1,42 @@
+#ifndef GSTSIDPLAYFPENGINEPOOL_H
+#define GSTSIDPLAYFPENGINEPOOL_H
+
+
+#include <glib.h>
+#include <sidplayfp/sidplayfp.h>
+#include <sidplayfp/builders/residfp.h>
+
+
+/* A sidplayfp engine together with the ReSIDfp builder that created
+ * its SIDs. Creating the SIDs (which builds the ReSIDfp filter tables),
+ * setting the ROMs, and configuring the engine is expensive, so engines
+ * are not destroyed when a decoder is done with them. Instead, they are
+ * kept in a process-wide pool, keyed by a string which describes the
+ * configuration (models, sampling, output format, ROMs). A decoder which
+ * needs the same configuration later only has to load its tune into the
+ * engine. */
+struct GstSidplayfpPooledEngine
+{
+	GstSidplayfpPooledEngine(gchar const *config_key);
+	~GstSidplayfpPooledEngine();
+
+	sidplayfp engine;
+	ReSIDfpBuilder builder;
+
+	gchar *config_key;
+	/* set by the user once the engine is fully configured;
+	 * engines that are not configured are not put back in the pool */
+	gboolean configured;
+};
+
+
+/* Returns an idle engine with the given configuration if the pool has one
+ * (its "configured" field is TRUE then), or a new, unconfigured engine
+ * otherwise. */
+GstSidplayfpPooledEngine* gst_sidplayfp_engine_pool_acquire(gchar const *config_key);
+
+/* Unloads the tune from the engine, and puts it back in the pool. */
+void gst_sidplayfp_engine_pool_release(GstSidplayfpPooledEngine *pooled_engine);
+
+
+#endif
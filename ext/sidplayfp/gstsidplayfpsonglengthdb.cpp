@@ -0,0 +1,329 @@
+#ifdef HAVE_CONFIG_H
+ #include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "gstsidplayfpsonglengthdb.h"
+
+
+GST_DEBUG_CATEGORY_STATIC(sidplayfp_songlength_db_debug);
+#define GST_CAT_DEFAULT sidplayfp_songlength_db_debug
+
+
+#define MD5_STRING_LENGTH 32
+
+
+struct _GstSidplayfpSonglengthDb
+{
+	volatile gint refcount;
+
+	gchar *path;
+	/* modification time and size of the file at the time it was parsed */
+	gint64 mtime;
+	gint64 size;
+
+	gboolean full_file_md5;
+
+	/* MD5 string -> gst_sidplayfp_songlength_entry */
+	GHashTable *entries;
+};
+
+
+typedef struct
+{
+	guint num_songs;
+	gint *lengths; /* in milliseconds; -1 = unknown */
+}
+gst_sidplayfp_songlength_entry;
+
+
+/* The process-wide index cache, keyed by path. The cache itself
+ * holds one reference to each index. */
+G_LOCK_DEFINE_STATIC(songlength_dbs);
+static GHashTable *songlength_dbs = NULL;
+
+
+static GstSidplayfpSonglengthDb* gst_sidplayfp_songlength_db_parse(gchar const *path, GStatBuf const *file_stat, GError **error);
+static gboolean gst_sidplayfp_songlength_db_parse_line(GstSidplayfpSonglengthDb *db, gchar *line);
+static gint gst_sidplayfp_songlength_db_parse_time(gchar **str);
+static void gst_sidplayfp_songlength_entry_free(gpointer data);
+
+
+
+GstSidplayfpSonglengthDb* gst_sidplayfp_songlength_db_get(gchar const *path, GError **error)
+{
+	GstSidplayfpSonglengthDb *db;
+	GStatBuf file_stat;
+
+	g_return_val_if_fail(path != NULL, NULL);
+
+	G_LOCK(songlength_dbs);
+
+	if (songlength_dbs == NULL)
+	{
+		GST_DEBUG_CATEGORY_INIT(sidplayfp_songlength_db_debug, "sidplayfpsonglengthdb", 0, "HVSC song length database");
+		songlength_dbs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)gst_sidplayfp_songlength_db_unref);
+	}
+
+	if (g_stat(path, &file_stat) != 0)
+	{
+		int saved_errno = errno;
+		G_UNLOCK(songlength_dbs);
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno), "Could not access %s: %s", path, g_strerror(saved_errno));
+		return NULL;
+	}
+
+	db = (GstSidplayfpSonglengthDb *)g_hash_table_lookup(songlength_dbs, path);
+
+	if ((db != NULL) && ((db->mtime != gint64(file_stat.st_mtime)) || (db->size != gint64(file_stat.st_size))))
+	{
+		GST_DEBUG("song length database %s changed since it was parsed - reloading", path);
+		db = NULL;
+	}
+
+	if (db == NULL)
+	{
+		/* Parsing is done with the lock held, so that instances which
+		 * request the same database at the same time wait for this parse
+		 * instead of parsing it again. Users of a replaced index keep
+		 * their own reference to it. */
+		db = gst_sidplayfp_songlength_db_parse(path, &file_stat, error);
+		if (db == NULL)
+		{
+			G_UNLOCK(songlength_dbs);
+			return NULL;
+		}
+
+		g_hash_table_replace(songlength_dbs, g_strdup(path), db);
+	}
+	else
+		GST_LOG("using already parsed song length database %s", path);
+
+	gst_sidplayfp_songlength_db_ref(db);
+
+	G_UNLOCK(songlength_dbs);
+
+	return db;
+}
+
+
+GstSidplayfpSonglengthDb* gst_sidplayfp_songlength_db_ref(GstSidplayfpSonglengthDb *db)
+{
+	g_return_val_if_fail(db != NULL, NULL);
+	g_atomic_int_inc(&(db->refcount));
+	return db;
+}
+
+
+void gst_sidplayfp_songlength_db_unref(GstSidplayfpSonglengthDb *db)
+{
+	g_return_if_fail(db != NULL);
+
+	if (!g_atomic_int_dec_and_test(&(db->refcount)))
+		return;
+
+	GST_DEBUG("freeing song length database index for %s", db->path);
+
+	g_hash_table_unref(db->entries);
+	g_free(db->path);
+	g_free(db);
+}
+
+
+gboolean gst_sidplayfp_songlength_db_uses_full_file_md5(GstSidplayfpSonglengthDb const *db)
+{
+	g_return_val_if_fail(db != NULL, FALSE);
+	return db->full_file_md5;
+}
+
+
+gint gst_sidplayfp_songlength_db_lookup(GstSidplayfpSonglengthDb const *db, gchar const *md5, guint song_nr)
+{
+	gst_sidplayfp_songlength_entry const *entry;
+
+	g_return_val_if_fail(db != NULL, -1);
+	g_return_val_if_fail(md5 != NULL, -1);
+
+	entry = (gst_sidplayfp_songlength_entry const *)g_hash_table_lookup(db->entries, md5);
+	if ((entry == NULL) || (song_nr < 1) || (song_nr > entry->num_songs))
+		return -1;
+
+	return entry->lengths[song_nr - 1];
+}
+
+
+static GstSidplayfpSonglengthDb* gst_sidplayfp_songlength_db_parse(gchar const *path, GStatBuf const *file_stat, GError **error)
+{
+	GstSidplayfpSonglengthDb *db;
+	gchar *contents, *line, *line_end;
+	gchar *lowercase_path;
+	gsize contents_size;
+	guint line_nr, num_invalid_lines;
+
+	if (!g_file_get_contents(path, &contents, &contents_size, error))
+		return NULL;
+
+	db = g_new0(GstSidplayfpSonglengthDb, 1);
+	db->refcount = 1;
+	db->path = g_strdup(path);
+	db->mtime = file_stat->st_mtime;
+	db->size = file_stat->st_size;
+	db->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, gst_sidplayfp_songlength_entry_free);
+
+	/* Songlengths.md5 has the same syntax as Songlengths.txt,
+	 * so the MD5 kind can only be told apart by the filename */
+	lowercase_path = g_ascii_strdown(path, -1);
+	db->full_file_md5 = g_str_has_suffix(lowercase_path, ".md5");
+	g_free(lowercase_path);
+
+	num_invalid_lines = 0;
+	for (line = contents, line_nr = 1; line < (contents + contents_size); line = line_end + 1, ++line_nr)
+	{
+		line_end = strchr(line, '\n');
+		if (line_end == NULL)
+			line_end = contents + contents_size;
+		*line_end = 0;
+
+		if (!gst_sidplayfp_songlength_db_parse_line(db, line))
+		{
+			GST_LOG("%s: skipping invalid line %u", path, line_nr);
+			++num_invalid_lines;
+		}
+	}
+
+	g_free(contents);
+
+	GST_DEBUG(
+		"parsed song length database %s:  %u entries  %u invalid lines  full file MD5: %d",
+		path,
+		g_hash_table_size(db->entries),
+		num_invalid_lines,
+		db->full_file_md5
+	);
+
+	return db;
+}
+
+
+static gboolean gst_sidplayfp_songlength_db_parse_line(GstSidplayfpSonglengthDb *db, gchar *line)
+{
+	/* Entries look like this:
+	 *   <32 hex digits MD5>=<length of song 1> <length of song 2> ...
+	 * with lengths in the format mm:ss, optionally followed by .SSS
+	 * milliseconds and a parenthesized attribute like (G) .
+	 * Lines starting with ; are comments, lines starting with [ are
+	 * section headers. */
+
+	gchar *separator, *md5, *times;
+	GArray *lengths;
+	gst_sidplayfp_songlength_entry *entry;
+	guint i;
+
+	line = g_strstrip(line);
+	if ((line[0] == 0) || (line[0] == ';') || (line[0] == '['))
+		return TRUE;
+
+	separator = strchr(line, '=');
+	if (separator == NULL)
+		return FALSE;
+	*separator = 0;
+
+	md5 = g_strstrip(line);
+	if (strlen(md5) != MD5_STRING_LENGTH)
+		return FALSE;
+	for (i = 0; i < MD5_STRING_LENGTH; ++i)
+	{
+		if (!g_ascii_isxdigit(md5[i]))
+			return FALSE;
+	}
+
+	lengths = g_array_new(FALSE, FALSE, sizeof(gint));
+	times = separator + 1;
+	while (TRUE)
+	{
+		gint length;
+
+		while (g_ascii_isspace(*times))
+			++times;
+		if (*times == 0)
+			break;
+
+		length = gst_sidplayfp_songlength_db_parse_time(&times);
+		if (length < 0)
+		{
+			g_array_free(lengths, TRUE);
+			return FALSE;
+		}
+
+		g_array_append_val(lengths, length);
+	}
+
+	if (lengths->len == 0)
+	{
+		g_array_free(lengths, TRUE);
+		return FALSE;
+	}
+
+	entry = g_new(gst_sidplayfp_songlength_entry, 1);
+	entry->num_songs = lengths->len;
+	entry->lengths = (gint *)g_array_free(lengths, FALSE);
+
+	/* createMD5() and GChecksum both produce lowercase hex digits */
+	g_hash_table_replace(db->entries, g_ascii_strdown(md5, -1), entry);
+
+	return TRUE;
+}
+
+
+static gint gst_sidplayfp_songlength_db_parse_time(gchar **str)
+{
+	gchar *cur = *str;
+	gint64 minutes, seconds, milliseconds;
+	gint digit_factor;
+
+	if (!g_ascii_isdigit(*cur))
+		return -1;
+	minutes = g_ascii_strtoll(cur, &cur, 10);
+
+	if ((*cur != ':') || !g_ascii_isdigit(cur[1]))
+		return -1;
+	seconds = g_ascii_strtoll(cur + 1, &cur, 10);
+
+	milliseconds = 0;
+	if (*cur == '.')
+	{
+		/* fractional part; only the first three digits matter */
+		++cur;
+		for (digit_factor = 100; g_ascii_isdigit(*cur); ++cur, digit_factor /= 10)
+			milliseconds += (*cur - '0') * digit_factor;
+	}
+
+	/* skip attributes */
+	if (*cur == '(')
+	{
+		gchar *attr_end = strchr(cur, ')');
+		if (attr_end == NULL)
+			return -1;
+		cur = attr_end + 1;
+	}
+
+	if ((*cur != 0) && !g_ascii_isspace(*cur))
+		return -1;
+
+	*str = cur;
+
+	if ((minutes > (G_MAXINT / 60000 - 1)) || (seconds >= 60))
+		return -1;
+
+	return gint(minutes * 60000 + seconds * 1000 + milliseconds);
+}
+
+
+static void gst_sidplayfp_songlength_entry_free(gpointer data)
+{
+	gst_sidplayfp_songlength_entry *entry = (gst_sidplayfp_songlength_entry *)data;
+	g_free(entry->lengths);
+	g_free(entry);
+}
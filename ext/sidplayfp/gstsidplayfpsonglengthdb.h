@@ -0,0 +1,45 @@
+#ifndef GSTSIDPLAYFPSONGLENGTHDB_H
+#define GSTSIDPLAYFPSONGLENGTHDB_H
+
+
+#include <gst/gst.h>
+
+
+G_BEGIN_DECLS
+
+
+/* Index of an HVSC song length database, keyed by the MD5 of the tune.
+ *
+ * Parsing the database takes a while, since it contains entries for
+ * every tune in the HVSC. The indices are therefore shared process-wide:
+ * gst_sidplayfp_songlength_db_get() only parses a database file the
+ * first time it is requested, and again if its modification time changed
+ * since then. Indices are immutable after parsing, so lookups need no
+ * locking. They are refcounted; an index that got replaced by a reloaded
+ * one stays valid until its last user unrefs it.
+ *
+ * Both the classic Songlengths.txt format and the newer Songlengths.md5
+ * format are supported. The two formats use different MD5 sums: the old
+ * one is computed by SidTune::createMD5() over certain parts of the tune,
+ * the new one is the MD5 of the entire file. Use
+ * gst_sidplayfp_songlength_db_uses_full_file_md5() to find out which one
+ * to pass to the lookup function. */
+typedef struct _GstSidplayfpSonglengthDb GstSidplayfpSonglengthDb;
+
+
+GstSidplayfpSonglengthDb* gst_sidplayfp_songlength_db_get(gchar const *path, GError **error);
+GstSidplayfpSonglengthDb* gst_sidplayfp_songlength_db_ref(GstSidplayfpSonglengthDb *db);
+void gst_sidplayfp_songlength_db_unref(GstSidplayfpSonglengthDb *db);
+
+gboolean gst_sidplayfp_songlength_db_uses_full_file_md5(GstSidplayfpSonglengthDb const *db);
+
+/* song_nr is the sidplayfp song number, that is, it starts at 1.
+ * Returns the length in milliseconds, or -1 if the database has no
+ * length for this song. */
+gint gst_sidplayfp_songlength_db_lookup(GstSidplayfpSonglengthDb const *db, gchar const *md5, guint song_nr);
+
+
+G_END_DECLS
+
+
+#endif
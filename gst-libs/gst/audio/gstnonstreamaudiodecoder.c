@@ -155,6 +155,21 @@
  *       unless it is set to NULL. Subclasses should reset internal loop counters
  *       in this function.
  *     </para></listitem>
+ *     <listitem><para>
+ *       Seek events with the SEGMENT flag are supported. Once the seek's stop
+ *       position is reached, or @decode returns FALSE, a SEGMENT_DONE message
+ *       is posted and a SEGMENT_DONE event is sent downstream instead of EOS.
+ *       Applications can then issue non-flushing segment seeks to loop an
+ *       arbitrary range seamlessly. Non-flushing seeks keep the running time
+ *       going, so no flush and no new preroll happens in between.
+ *     </para></listitem>
+ *     <listitem><para>
+ *       If the metadata-only property is set, the decoder output task sends EOS
+ *       right away instead of calling @decode. Tags, TOC, duration, caps, and
+ *       the segment are still sent during loading, so elements like discoverer
+ *       get all the information they need without any samples being rendered.
+ *       Seeking and switching subsongs are not possible in this mode.
+ *     </para></listitem>
  *   </itemizedlist>
  * </listitem>
  * </orderedlist>
@@ -201,7 +216,9 @@ enum
 	PROP_CURRENT_SUBSONG,
 	PROP_SUBSONG_MODE,
 	PROP_NUM_LOOPS,
-	PROP_OUTPUT_MODE
+	PROP_OUTPUT_MODE,
+	PROP_METADATA_ONLY,
+	PROP_NUM_VOICES
 };
 
 #define DEFAULT_CURRENT_SUBSONG 0
@@ -209,6 +226,7 @@ enum
 #define DEFAULT_NUM_SUBSONGS 0
 #define DEFAULT_NUM_LOOPS 0
 #define DEFAULT_OUTPUT_MODE GST_NONSTREM_AUDIO_OUTPUT_MODE_STEADY
+#define DEFAULT_METADATA_ONLY FALSE
 
 
 
@@ -223,6 +241,8 @@ static void gst_nonstream_audio_decoder_set_property(GObject *object, guint prop
 static void gst_nonstream_audio_decoder_get_property(GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 
 static GstStateChangeReturn gst_nonstream_audio_decoder_change_state(GstElement *element, GstStateChange transition);
+static GstPad* gst_nonstream_audio_decoder_request_new_pad(GstElement *element, GstPadTemplate *templ, gchar const *name, GstCaps const *caps);
+static void gst_nonstream_audio_decoder_release_pad(GstElement *element, GstPad *pad);
 
 static gboolean gst_nonstream_audio_decoder_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
 static gboolean gst_nonstream_audio_decoder_sink_query(GstPad *pad, GstObject *parent, GstQuery *query);
@@ -248,16 +268,27 @@ static gboolean gst_nonstream_audio_decoder_finish_load(GstNonstreamAudioDecoder
 static gboolean gst_nonstream_audio_decoder_start_task(GstNonstreamAudioDecoder *dec);
 static gboolean gst_nonstream_audio_decoder_stop_task(GstNonstreamAudioDecoder *dec);
 
-static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioDecoder *dec, guint new_subsong, guint32 const *seqnum);
+static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioDecoder *dec, guint new_subsong, GstClockTime start_position, guint32 const *seqnum);
 
 static void gst_nonstream_audio_decoder_update_toc(GstNonstreamAudioDecoder *dec, GstNonstreamAudioDecoderClass *klass);
+static gboolean gst_nonstream_audio_decoder_seek_to_toc_entry(GstNonstreamAudioDecoder *dec, gchar const *uid, guint32 seqnum);
 static void gst_nonstream_audio_decoder_update_subsong_duration(GstNonstreamAudioDecoder *dec, GstClockTime duration);
+static void gst_nonstream_audio_decoder_refresh_subsong_info(GstNonstreamAudioDecoder *dec, GstNonstreamAudioDecoderClass *klass);
 static void gst_nonstream_audio_decoder_output_new_segment(GstNonstreamAudioDecoder *dec, GstClockTime start_position);
+static GstClockTime gst_nonstream_audio_decoder_snap_seek_position(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime stop, GstSeekFlags flags);
+static void gst_nonstream_audio_decoder_scale_segment(GstSegment *segment, gdouble factor);
 static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *dec, GstEvent *event);
 
 static GstTagList * gst_nonstream_audio_decoder_add_main_tags(GstNonstreamAudioDecoder *dec, GstTagList *tags);
 
+static gboolean gst_nonstream_audio_decoder_push_src_event(GstNonstreamAudioDecoder *dec, GstEvent *event);
+static GstEvent* gst_nonstream_audio_decoder_new_voice_stream_start(GstNonstreamAudioDecoder *dec, GstPad *voice_srcpad, GstEvent *stream_start_event);
+static gboolean gst_nonstream_audio_decoder_copy_sticky_event(GstPad *pad, GstEvent **event, gpointer user_data);
+static guint gst_nonstream_audio_decoder_get_voice_srcpads(GstNonstreamAudioDecoder *dec, GstPad ***voice_srcpads, guint **voices);
+
+static GstBuffer* gst_nonstream_audio_decoder_fit_output_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *buffer, guint num_samples, guint num_clipped_samples);
 static void gst_nonstream_audio_decoder_output_task(GstNonstreamAudioDecoder *dec);
+static void gst_nonstream_audio_decoder_output_segment_end(GstNonstreamAudioDecoder *dec);
 
 static char const * get_seek_type_name(GstSeekType seek_type);
 
@@ -376,6 +407,8 @@ static void gst_nonstream_audio_decoder_class_init(GstNonstreamAudioDecoderClass
 	object_class->set_property = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_set_property);
 	object_class->get_property = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_get_property);
 	element_class->change_state = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_change_state);
+	element_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_request_new_pad);
+	element_class->release_pad = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_release_pad);
 
 	klass->seek = NULL;
 	klass->tell = NULL;
@@ -398,6 +431,9 @@ static void gst_nonstream_audio_decoder_class_init(GstNonstreamAudioDecoderClass
 
 	klass->decode = NULL;
 
+	klass->get_num_voices = NULL;
+	klass->decode_voices = NULL;
+
 	klass->negotiate = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_negotiate_default);
 
 	klass->decide_allocation = GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_decide_allocation_default);
@@ -456,6 +492,31 @@ static void gst_nonstream_audio_decoder_class_init(GstNonstreamAudioDecoderClass
 			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
 		)
 	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_METADATA_ONLY,
+		g_param_spec_boolean(
+			"metadata-only",
+			"Metadata only",
+			"Only load the media to produce tags, TOC, and durations, then send EOS without decoding any samples (must be set before the media is loaded)",
+			DEFAULT_METADATA_ONLY,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS
+		)
+	);
+
+	g_object_class_install_property(
+		object_class,
+		PROP_NUM_VOICES,
+		g_param_spec_uint(
+			"num-voices",
+			"Number of voices",
+			"Number of voices that can be rendered separately over voice_%u request pads (0 if not supported or if no media is loaded yet)",
+			0, G_MAXUINT,
+			0,
+			G_PARAM_READABLE | G_PARAM_STATIC_STRINGS
+		)
+	);
 }
 
 
@@ -470,6 +531,7 @@ static void gst_nonstream_audio_decoder_init(GstNonstreamAudioDecoder *dec, GstN
 	dec->subsong_mode = DEFAULT_SUBSONG_MODE;
 	dec->output_mode = DEFAULT_OUTPUT_MODE;
 	dec->num_loops = DEFAULT_NUM_LOOPS;
+	dec->metadata_only = DEFAULT_METADATA_ONLY;
 
 	/* Calling this here, not in the NULL->READY state change,
 	 * to make sure get_property calls return valid values */
@@ -478,6 +540,10 @@ static void gst_nonstream_audio_decoder_init(GstNonstreamAudioDecoder *dec, GstN
 	dec->input_data_adapter = gst_adapter_new();
 	g_mutex_init(&(dec->mutex));
 
+	dec->voice_srcpads = NULL;
+	dec->loading_cancelled = 0;
+	dec->subsong_info_changed = 0;
+
 	{
 		/* set up src pad */
 
@@ -515,6 +581,9 @@ static void gst_nonstream_audio_decoder_finalize(GObject *object)
 	g_mutex_clear(&(dec->mutex));
 	g_object_unref(G_OBJECT(dec->input_data_adapter));
 
+	/* the pads themselves are owned by the element */
+	g_list_free(dec->voice_srcpads);
+
 	G_OBJECT_CLASS(gst_nonstream_audio_decoder_parent_class)->finalize(object);
 }
 
@@ -582,7 +651,7 @@ static void gst_nonstream_audio_decoder_set_property(GObject *object, guint prop
 		case PROP_CURRENT_SUBSONG:
 		{
 			guint new_subsong = g_value_get_uint(value);
-			gst_nonstream_audio_decoder_switch_to_subsong(dec, new_subsong, NULL);
+			gst_nonstream_audio_decoder_switch_to_subsong(dec, new_subsong, GST_CLOCK_TIME_NONE, NULL);
 
 			break;
 		}
@@ -658,6 +727,18 @@ static void gst_nonstream_audio_decoder_set_property(GObject *object, guint prop
 			break;
 		}
 
+		case PROP_METADATA_ONLY:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			if (dec->loaded_mode)
+				GST_WARNING_OBJECT(dec, "media is already loaded - cannot switch metadata-only mode anymore");
+			else
+				dec->metadata_only = g_value_get_boolean(value);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+
+			break;
+		}
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -703,6 +784,27 @@ static void gst_nonstream_audio_decoder_get_property(GObject *object, guint prop
 			break;
 		}
 
+		case PROP_METADATA_ONLY:
+		{
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			g_value_set_boolean(value, dec->metadata_only);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+		}
+
+		case PROP_NUM_VOICES:
+		{
+			GstNonstreamAudioDecoderClass *klass = GST_NONSTREAM_AUDIO_DECODER_GET_CLASS(dec);
+
+			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+			if (dec->loaded_mode && (klass->get_num_voices != NULL))
+				g_value_set_uint(value, klass->get_num_voices(dec));
+			else
+				g_value_set_uint(value, 0);
+			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+			break;
+		}
+
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 			break;
@@ -715,6 +817,23 @@ static GstStateChangeReturn gst_nonstream_audio_decoder_change_state(GstElement
 {
 	GstStateChangeReturn ret;
 
+	switch (transition)
+	{
+		case GST_STATE_CHANGE_READY_TO_PAUSED:
+			g_atomic_int_set(&(GST_NONSTREAM_AUDIO_DECODER(element)->loading_cancelled), 0);
+			break;
+
+		case GST_STATE_CHANGE_PAUSED_TO_READY:
+			/* Flag this *before* calling the parent class' change_state vfunc,
+			 * since deactivating the sinkpad waits for the chain function to
+			 * finish, and the chain function might be in the middle of loading */
+			g_atomic_int_set(&(GST_NONSTREAM_AUDIO_DECODER(element)->loading_cancelled), 1);
+			break;
+
+		default:
+			break;
+	}
+
 	ret = GST_ELEMENT_CLASS(gst_nonstream_audio_decoder_parent_class)->change_state(element, transition);
 	if (ret == GST_STATE_CHANGE_FAILURE)
 		return ret;
@@ -786,6 +905,108 @@ static GstStateChangeReturn gst_nonstream_audio_decoder_change_state(GstElement
 
 
 
+static GstPad* gst_nonstream_audio_decoder_request_new_pad(GstElement *element, GstPadTemplate *templ, gchar const *name, G_GNUC_UNUSED GstCaps const *caps)
+{
+	GstNonstreamAudioDecoder *dec;
+	GstNonstreamAudioDecoderClass *klass;
+	GstPad *voice_srcpad;
+	GList *walk;
+	guint voice;
+	gchar *pad_name;
+
+	dec = GST_NONSTREAM_AUDIO_DECODER(element);
+	klass = GST_NONSTREAM_AUDIO_DECODER_GET_CLASS(dec);
+
+	if (klass->decode_voices == NULL)
+	{
+		GST_WARNING_OBJECT(dec, "subclass cannot render voices separately - cannot create voice pads");
+		return NULL;
+	}
+
+	if ((GST_PAD_TEMPLATE_DIRECTION(templ) != GST_PAD_SRC) || (g_strcmp0(GST_PAD_TEMPLATE_NAME_TEMPLATE(templ), "voice_%u") != 0))
+	{
+		GST_WARNING_OBJECT(dec, "pad template \"%s\" is not a voice pad template", GST_PAD_TEMPLATE_NAME_TEMPLATE(templ));
+		return NULL;
+	}
+
+	GST_OBJECT_LOCK(dec);
+
+	if ((name != NULL) && (sscanf(name, "voice_%u", &voice) == 1))
+	{
+		for (walk = dec->voice_srcpads; walk != NULL; walk = walk->next)
+		{
+			if (GPOINTER_TO_UINT(gst_pad_get_element_private(GST_PAD(walk->data))) == voice)
+			{
+				GST_OBJECT_UNLOCK(dec);
+				GST_WARNING_OBJECT(dec, "there is already a pad for voice %u", voice);
+				return NULL;
+			}
+		}
+	}
+	else
+	{
+		/* no voice specified -> pick the lowest one that has no pad yet */
+		voice = 0;
+		walk = dec->voice_srcpads;
+		while (walk != NULL)
+		{
+			if (GPOINTER_TO_UINT(gst_pad_get_element_private(GST_PAD(walk->data))) == voice)
+			{
+				++voice;
+				walk = dec->voice_srcpads;
+			}
+			else
+				walk = walk->next;
+		}
+	}
+
+	GST_OBJECT_UNLOCK(dec);
+
+	pad_name = g_strdup_printf("voice_%u", voice);
+	voice_srcpad = gst_pad_new_from_template(templ, pad_name);
+	g_free(pad_name);
+
+	gst_pad_set_element_private(voice_srcpad, GUINT_TO_POINTER(voice));
+	gst_pad_set_event_function(voice_srcpad, GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_src_event));
+	gst_pad_set_query_function(voice_srcpad, GST_DEBUG_FUNCPTR(gst_nonstream_audio_decoder_src_query));
+	gst_pad_use_fixed_caps(voice_srcpad);
+
+	if (GST_STATE(dec) > GST_STATE_READY)
+		gst_pad_set_active(voice_srcpad, TRUE);
+
+	GST_OBJECT_LOCK(dec);
+	dec->voice_srcpads = g_list_append(dec->voice_srcpads, voice_srcpad);
+	GST_OBJECT_UNLOCK(dec);
+
+	/* If playback already started, the stream-start, caps, and segment
+	 * events have been sent already. Give the new pad copies of these.
+	 * This is done after adding the pad to the list to make sure events
+	 * that are pushed in between are not lost. */
+	gst_pad_sticky_events_foreach(dec->srcpad, gst_nonstream_audio_decoder_copy_sticky_event, voice_srcpad);
+
+	GST_DEBUG_OBJECT(dec, "created pad %s:%s for voice %u", GST_DEBUG_PAD_NAME(voice_srcpad), voice);
+
+	gst_element_add_pad(element, voice_srcpad);
+
+	return voice_srcpad;
+}
+
+
+static void gst_nonstream_audio_decoder_release_pad(GstElement *element, GstPad *pad)
+{
+	GstNonstreamAudioDecoder *dec = GST_NONSTREAM_AUDIO_DECODER(element);
+
+	GST_DEBUG_OBJECT(dec, "releasing pad %s:%s", GST_DEBUG_PAD_NAME(pad));
+
+	GST_OBJECT_LOCK(dec);
+	dec->voice_srcpads = g_list_remove(dec->voice_srcpads, pad);
+	GST_OBJECT_UNLOCK(dec);
+
+	gst_pad_set_active(pad, FALSE);
+	gst_element_remove_pad(element, pad);
+}
+
+
 static gboolean gst_nonstream_audio_decoder_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
 {
 	gboolean res = FALSE;
@@ -918,7 +1139,7 @@ static GstFlowReturn gst_nonstream_audio_decoder_chain(G_GNUC_UNUSED GstPad *pad
 			if (gst_nonstream_audio_decoder_load_from_buffer(dec, adapter_buffer))
 				flow_ret = gst_nonstream_audio_decoder_start_task(dec) ? GST_FLOW_OK : GST_FLOW_ERROR;
 			else
-				flow_ret = GST_FLOW_ERROR;
+				flow_ret = gst_nonstream_audio_decoder_is_loading_cancelled(dec) ? GST_FLOW_FLUSHING : GST_FLOW_ERROR;
 		}
 	}
 
@@ -952,14 +1173,17 @@ static gboolean gst_nonstream_audio_decoder_src_event(GstPad *pad, GstObject *pa
 			guint32 seqnum;
 
 			gst_event_parse_toc_select(event, &uid);
+			seqnum = gst_event_get_seqnum(event);
 
-			if ((uid != NULL) && (sscanf(uid, "nonstream-subsong-%05u", &subsong_idx) == 1))
+			if ((uid != NULL) && gst_nonstream_audio_decoder_seek_to_toc_entry(dec, uid, seqnum))
+			{
+				GST_DEBUG_OBJECT(dec, "received TOC select event (sequence number %" G_GUINT32_FORMAT "), seeked to entry \"%s\"", seqnum, uid);
+			}
+			else if ((uid != NULL) && (sscanf(uid, "nonstream-subsong-%05u", &subsong_idx) == 1))
 			{
-				seqnum = gst_event_get_seqnum(event);
-
 				GST_DEBUG_OBJECT(dec, "received TOC select event (sequence number %" G_GUINT32_FORMAT "), switching to subsong %u", seqnum, subsong_idx);
 
-				gst_nonstream_audio_decoder_switch_to_subsong(dec, subsong_idx, &seqnum);
+				gst_nonstream_audio_decoder_switch_to_subsong(dec, subsong_idx, GST_CLOCK_TIME_NONE, &seqnum);
 			}
 
 			g_free(uid);
@@ -1075,6 +1299,14 @@ static gboolean gst_nonstream_audio_decoder_src_query(GstPad *pad, GstObject *pa
 
 			gst_query_parse_seeking(query, &fmt, NULL, NULL, NULL);
 
+			if (dec->metadata_only)
+			{
+				GST_DEBUG_OBJECT(parent, "seeking query received in metadata-only mode -> can seek: no");
+				gst_query_set_seeking(query, fmt, FALSE, 0, -1);
+				res = TRUE;
+				break;
+			}
+
 			GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
 			duration = dec->subsong_duration;
 			GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
@@ -1181,7 +1413,7 @@ static gboolean gst_nonstream_audio_decoder_negotiate_default(GstNonstreamAudioD
 
 	GST_DEBUG_OBJECT(dec, "setting src caps %" GST_PTR_FORMAT, (gpointer)caps);
 
-	res = gst_pad_push_event(dec->srcpad, gst_event_new_caps(caps));
+	res = gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_caps(caps));
 	/* clear any pending reconfigure flag */
 	gst_pad_check_reconfigure(dec->srcpad);
 
@@ -1350,7 +1582,10 @@ static gboolean gst_nonstream_audio_decoder_finish_load(GstNonstreamAudioDecoder
 
 	if (!load_ok)
 	{
-		GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL), ("Loading failed"));
+		if (gst_nonstream_audio_decoder_is_loading_cancelled(dec))
+			GST_DEBUG_OBJECT(dec, "loading was cancelled");
+		else
+			GST_ELEMENT_ERROR(dec, STREAM, DECODE, (NULL), ("Loading failed"));
 		return FALSE;
 	}
 
@@ -1395,7 +1630,7 @@ static gboolean gst_nonstream_audio_decoder_finish_load(GstNonstreamAudioDecoder
 		if (tags != NULL)
 			tags = gst_nonstream_audio_decoder_add_main_tags(dec, tags);
 		if (tags != NULL)
-			gst_pad_push_event(dec->srcpad, gst_event_new_tag(tags));
+			gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_tag(tags));
 	}
 	else
 	{
@@ -1403,7 +1638,7 @@ static gboolean gst_nonstream_audio_decoder_finish_load(GstNonstreamAudioDecoder
 
 		GstTagList *tags = gst_tag_list_new_empty();
 		tags = gst_nonstream_audio_decoder_add_main_tags(dec, tags);
-		gst_pad_push_event(dec->srcpad, gst_event_new_tag(tags));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_tag(tags));
 	}
 
 
@@ -1418,7 +1653,7 @@ static gboolean gst_nonstream_audio_decoder_finish_load(GstNonstreamAudioDecoder
 
 		event = gst_event_new_stream_start(stream_id);
 		gst_event_set_group_id(event, gst_util_group_id_next());
-		gst_pad_push_event(dec->srcpad, event);
+		gst_nonstream_audio_decoder_push_src_event(dec, event);
 		g_free(stream_id);
 	}
 
@@ -1471,7 +1706,10 @@ static gboolean gst_nonstream_audio_decoder_stop_task(GstNonstreamAudioDecoder *
 }
 
 
-static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioDecoder *dec, guint new_subsong, guint32 const *seqnum)
+/* If start_position is valid, playback of the new subsong starts there
+ * instead of at the subsong's initial position. The seek is done under
+ * the same flush as the switch itself. */
+static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioDecoder *dec, guint new_subsong, GstClockTime start_position, guint32 const *seqnum)
 {
 	gboolean ret = TRUE;
 	GstNonstreamAudioDecoderClass *klass = GST_NONSTREAM_AUDIO_DECODER_GET_CLASS(dec);
@@ -1510,6 +1748,13 @@ static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioD
 			goto finish_unlock;
 		}
 
+		if (dec->metadata_only)
+		{
+			GST_DEBUG_OBJECT(dec, "metadata-only mode is enabled - not switching to subsong %u", new_subsong);
+			ret = FALSE;
+			goto finish_unlock;
+		}
+
 		if (klass->get_num_subsongs)
 		{
 			guint num_subsongs = klass->get_num_subsongs(dec);
@@ -1539,7 +1784,7 @@ static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioD
 		else
 			GST_DEBUG_OBJECT(dec, "sending flush start event (no sequence number)");
 
-		gst_pad_push_event(dec->srcpad, gst_event_ref(fevent));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_ref(fevent));
 	        /* unlock upstream pull_range */
 		if (klass->loads_from_sinkpad)
 		        gst_pad_push_event(dec->sinkpad, fevent);
@@ -1567,10 +1812,22 @@ static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioD
 				new_position = 0;
 			GST_WARNING_OBJECT(dec, "switching to new subsong %u failed", new_subsong);
 		}
+		else if (GST_CLOCK_TIME_IS_VALID(start_position))
+		{
+			GstClockTime seek_position = start_position;
 
-		/* Flushing seek resets the base time, which means num_decoded_samples
-		 * needs to be set to 0, since it defines the segment.base value */
+			if ((klass->seek != NULL) && klass->seek(dec, &seek_position))
+				new_position = seek_position;
+			else
+				GST_WARNING_OBJECT(dec, "could not seek to %" GST_TIME_FORMAT " in new subsong %u - starting at %" GST_TIME_FORMAT " instead", GST_TIME_ARGS(start_position), new_subsong, GST_TIME_ARGS(new_position));
+		}
+
+		/* Flushing resets the running time, so the segment for the new
+		 * subsong must start with base 0 (output_new_segment() continues
+		 * at the running time of the current segment's position) */
 		dec->num_decoded_samples = 0;
+		dec->cur_segment.base = 0;
+		dec->cur_segment.position = dec->cur_segment.start;
 
 
 		fevent = gst_event_new_flush_stop(TRUE);
@@ -1582,7 +1839,7 @@ static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioD
 		else
 			GST_DEBUG_OBJECT(dec, "sending flush stop event (no sequence number)");
 
-		gst_pad_push_event(dec->srcpad, gst_event_ref(fevent));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_ref(fevent));
 	        /* unlock upstream pull_range */
 		if (klass->loads_from_sinkpad)
 		        gst_pad_push_event(dec->sinkpad, fevent);
@@ -1605,7 +1862,7 @@ static gboolean gst_nonstream_audio_decoder_switch_to_subsong(GstNonstreamAudioD
 			if (subsong_tags != NULL)
 				subsong_tags = gst_nonstream_audio_decoder_add_main_tags(dec, subsong_tags);
 			if (subsong_tags != NULL)
-				gst_pad_push_event(dec->srcpad, gst_event_new_tag(subsong_tags));
+				gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_tag(subsong_tags));
 		}
 
 		GST_DEBUG_OBJECT(dec, "successfully switched to new subsong %u", new_subsong);
@@ -1663,7 +1920,7 @@ static void gst_nonstream_audio_decoder_update_toc(GstNonstreamAudioDecoder *dec
 		return;
 
 	num_subsongs = klass->get_num_subsongs(dec);
-	if (num_subsongs <= 1)
+	if ((num_subsongs <= 1) && (klass->fill_toc_entry == NULL))
 	{
 		GST_DEBUG_OBJECT(dec, "no need for a TOC since there is only one subsong");
 		return;
@@ -1706,6 +1963,10 @@ static void gst_nonstream_audio_decoder_update_toc(GstNonstreamAudioDecoder *dec
 		gst_toc_entry_set_start_stop_times(entry, 0, duration);
 		gst_toc_entry_set_tags(entry, tags);
 
+		/* Let the subclass add its own sub-entries */
+		if (klass->fill_toc_entry != NULL)
+			klass->fill_toc_entry(dec, i, entry);
+
 		/* NOTE: *not* adding loop count via gst_toc_entry_set_loop(), since
 		 * in GstNonstreamAudioDecoder, looping is a playback property, not
 		 * a property of the subsongs themselves */
@@ -1723,7 +1984,56 @@ static void gst_nonstream_audio_decoder_update_toc(GstNonstreamAudioDecoder *dec
 		g_free(uid);
 	}
 
-	gst_pad_push_event(dec->srcpad, gst_event_new_toc(dec->toc, FALSE));
+	gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_toc(dec->toc, FALSE));
+}
+
+
+static gboolean gst_nonstream_audio_decoder_seek_to_toc_entry(GstNonstreamAudioDecoder *dec, gchar const *uid, guint32 seqnum)
+{
+	GstTocEntry *entry, *subsong_entry;
+	guint subsong_idx = 0;
+	gint64 start = 0;
+	gboolean found = FALSE, other_subsong;
+	GstEvent *seek_event;
+
+	/* Look for a subclass-defined sub-entry with the given UID. The
+	 * subsong it belongs to is the topmost entry above it. Subsong
+	 * entries themselves are not handled here. */
+
+	GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+
+	if ((dec->toc != NULL) && ((entry = gst_toc_find_entry(dec->toc, uid)) != NULL) && (gst_toc_entry_get_parent(entry) != NULL))
+	{
+		subsong_entry = gst_toc_entry_get_parent(entry);
+		while (gst_toc_entry_get_parent(subsong_entry) != NULL)
+			subsong_entry = gst_toc_entry_get_parent(subsong_entry);
+
+		gst_toc_entry_get_start_stop_times(entry, &start, NULL);
+		found = (sscanf(gst_toc_entry_get_uid(subsong_entry), "nonstream-subsong-%05u", &subsong_idx) == 1);
+	}
+
+	other_subsong = (subsong_idx != dec->current_subsong);
+
+	GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+
+	if (!found)
+		return FALSE;
+
+	GST_DEBUG_OBJECT(dec, "TOC entry \"%s\" is in subsong %u and starts at %" GST_TIME_FORMAT, uid, subsong_idx, GST_TIME_ARGS(start));
+
+	/* If the entry is in another subsong, switch to it and start at the
+	 * entry, all under the flush of the switch. If the switch fails, do
+	 * not seek, since the entry's start time means nothing in the
+	 * current subsong. */
+	if (other_subsong)
+		return gst_nonstream_audio_decoder_switch_to_subsong(dec, subsong_idx, (GstClockTime)start, &seqnum);
+
+	seek_event = gst_event_new_seek(1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, GST_SEEK_TYPE_SET, start, GST_SEEK_TYPE_NONE, -1);
+	gst_event_set_seqnum(seek_event, seqnum);
+	/* do_seek() takes ownership over the event */
+	gst_nonstream_audio_decoder_do_seek(dec, seek_event);
+
+	return TRUE;
 }
 
 
@@ -1738,20 +2048,66 @@ static void gst_nonstream_audio_decoder_update_subsong_duration(GstNonstreamAudi
 }
 
 
+static void gst_nonstream_audio_decoder_refresh_subsong_info(GstNonstreamAudioDecoder *dec, GstNonstreamAudioDecoderClass *klass)
+{
+	/* must be called with lock */
+
+	GST_DEBUG_OBJECT(dec, "subsong information changed - updating duration and TOC");
+
+	if (klass->get_subsong_duration != NULL)
+	{
+		GstClockTime duration = klass->get_subsong_duration(dec, dec->current_subsong);
+		if (duration != dec->subsong_duration)
+			gst_nonstream_audio_decoder_update_subsong_duration(dec, duration);
+	}
+
+	gst_nonstream_audio_decoder_update_toc(dec, klass);
+}
+
+
 static void gst_nonstream_audio_decoder_output_new_segment(GstNonstreamAudioDecoder *dec, GstClockTime start_position)
 {
 	/* must be called with lock */
 
 	GstSegment segment;
+	guint64 running_time, stop_stream_time;
 
 	gst_segment_init(&segment, GST_FORMAT_TIME);
 
-	segment.base = gst_util_uint64_scale_int(dec->num_decoded_samples, GST_SECOND, dec->output_audio_info.rate);
+	/* keep the rates of the last seek; if the subclass applies a rate by
+	 * itself, it continues to do so after loops and subsong switches */
+	segment.rate = dec->cur_segment.rate;
+	segment.applied_rate = dec->cur_segment.applied_rate;
+
+	/* keep the flags of the last seek as well, otherwise a segment seek
+	 * would end with EOS instead of SEGMENT_DONE after a loop or subsong
+	 * switch (the reset flag only applies to the segment after a flush) */
+	segment.flags = dec->cur_segment.flags & ~GST_SEGMENT_FLAG_RESET;
+
+	/* The new segment continues where the running time of the current
+	 * one ends. This cannot be computed out of num_decoded_samples, since
+	 * the segments so far may have had different rates (a non-flushing
+	 * seek with a different rate keeps the running time that elapsed up
+	 * to that point in the base of its segment). */
+	running_time = gst_segment_to_running_time(&(dec->cur_segment), GST_FORMAT_TIME, dec->cur_segment.position);
+	segment.base = GST_CLOCK_TIME_IS_VALID(running_time) ? running_time : dec->cur_segment.base;
 	segment.start = 0;
 	segment.time = start_position;
 	segment.offset = 0;
 	segment.position = 0;
 
+	/* The stop position of the last seek (if there is one) is kept at the
+	 * same stream time. It is converted to the new segment, which starts
+	 * at start_position; its values are scaled by the rate the subclass
+	 * applies, like in do_seek(). If the new segment starts past the stop
+	 * position, it ends right away. */
+	stop_stream_time = GST_CLOCK_TIME_IS_VALID(dec->cur_segment.stop) ? gst_segment_to_stream_time(&(dec->cur_segment), GST_FORMAT_TIME, dec->cur_segment.stop) : GST_CLOCK_TIME_NONE;
+	if (GST_CLOCK_TIME_IS_VALID(stop_stream_time))
+	{
+		segment.stop = (stop_stream_time > start_position) ? (stop_stream_time - start_position) : 0;
+		gst_nonstream_audio_decoder_scale_segment(&segment, 1.0 / segment.applied_rate);
+	}
+
 	/* note that num_decoded_samples isn't being reset; it is the
 	 * analogue to the segment base value, and thus is supposed to
 	 * monotonically increase, except for when a flushing seek happens
@@ -1759,26 +2115,85 @@ static void gst_nonstream_audio_decoder_output_new_segment(GstNonstreamAudioDeco
 	 * the whole pipeline) */
 	dec->cur_pos_in_samples = 0;
 
-	/* stop/duration members are not set, on purpose - in case of loops,
-	 * new segments will be generated, which automatically put an implicit
-	 * end on the current segment (the segment implicitely "ends" when the
-	 * new one starts), and having a stop value might cause very slight
-	 * gaps occasionally due to slight jitter in the calculation of
-	 * base times etc. */
+	/* apart from the stop position of a seek, stop/duration members are
+	 * not set, on purpose - in case of loops, new segments will be
+	 * generated, which automatically put an implicit end on the current
+	 * segment (the segment implicitely "ends" when the new one starts),
+	 * and having a stop value might cause very slight gaps occasionally
+	 * due to slight jitter in the calculation of base times etc. */
 
-	GST_DEBUG_OBJECT(dec, "output new segment with base %" GST_TIME_FORMAT " time %" GST_TIME_FORMAT, GST_TIME_ARGS(segment.base), GST_TIME_ARGS(segment.time));
+	GST_DEBUG_OBJECT(dec, "output new segment with base %" GST_TIME_FORMAT " time %" GST_TIME_FORMAT " stop %" GST_TIME_FORMAT, GST_TIME_ARGS(segment.base), GST_TIME_ARGS(segment.time), GST_TIME_ARGS(segment.stop));
 
 	dec->cur_segment = segment;
 	dec->discont = TRUE;
 
-	gst_pad_push_event(dec->srcpad, gst_event_new_segment(&segment));
+	gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_segment(&segment));
+}
+
+
+static GstClockTime gst_nonstream_audio_decoder_snap_seek_position(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime stop, GstSeekFlags flags)
+{
+	/* must be called with lock */
+
+	GstClockTime point_before, point_after, snapped_position;
+	GstNonstreamAudioDecoderClass *klass = GST_NONSTREAM_AUDIO_DECODER_GET_CLASS(dec);
+
+	if (klass->find_seek_points == NULL)
+		return position;
+
+	point_before = position;
+	point_after = GST_CLOCK_TIME_NONE;
+	if (!klass->find_seek_points(dec, position, &point_before, &point_after))
+	{
+		GST_DEBUG_OBJECT(dec, "subclass could not find seek points around %" GST_TIME_FORMAT " - seeking to that position directly", GST_TIME_ARGS(position));
+		return position;
+	}
+
+	/* a seek point past the stop position is of no use */
+	if (GST_CLOCK_TIME_IS_VALID(stop) && GST_CLOCK_TIME_IS_VALID(point_after) && (point_after > stop))
+		point_after = GST_CLOCK_TIME_NONE;
+
+	if (!GST_CLOCK_TIME_IS_VALID(point_after))
+		snapped_position = point_before;
+	else if ((flags & GST_SEEK_FLAG_SNAP_NEAREST) == GST_SEEK_FLAG_SNAP_NEAREST)
+		snapped_position = ((position - point_before) <= (point_after - position)) ? point_before : point_after;
+	else if (flags & GST_SEEK_FLAG_SNAP_AFTER)
+		snapped_position = point_after;
+	else
+		snapped_position = point_before;
+
+	GST_DEBUG_OBJECT(
+		dec,
+		"snapped seek position %" GST_TIME_FORMAT " to %" GST_TIME_FORMAT " (seek points: before %" GST_TIME_FORMAT " after %" GST_TIME_FORMAT ")",
+		GST_TIME_ARGS(position),
+		GST_TIME_ARGS(snapped_position),
+		GST_TIME_ARGS(point_before),
+		GST_TIME_ARGS(point_after)
+	);
+
+	return snapped_position;
+}
+
+
+static void gst_nonstream_audio_decoder_scale_segment(GstSegment *segment, gdouble factor)
+{
+	/* Scales the distance of the position and stop values to the segment
+	 * start. This converts between media time and the output timeline if
+	 * the subclass applies a playback rate by itself. */
+
+	if (segment->position > segment->start)
+		segment->position = segment->start + (guint64)((segment->position - segment->start) * factor);
+	if (GST_CLOCK_TIME_IS_VALID(segment->stop) && (segment->stop > segment->start))
+		segment->stop = segment->start + (guint64)((segment->stop - segment->start) * factor);
 }
 
 
 static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *dec, GstEvent *event)
 {
-	gboolean res;
-	gdouble rate;
+	/* NOTE: this function takes ownership over the event in all cases */
+
+	gboolean res = FALSE;
+	gdouble rate, applied_rate;
 	GstFormat format;
 	GstSeekFlags flags;
 	GstSeekType start_type, stop_type;
@@ -1792,13 +2207,19 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 	if (klass->seek == NULL)
 	{
 		GST_DEBUG_OBJECT(dec, "cannot seek: subclass does not have seek() function defined");
-		return FALSE;
+		goto finish;
 	}
 
 	if (!dec->loaded_mode)
 	{
 		GST_DEBUG_OBJECT(dec, "nothing loaded yet - cannot seek");
-		return FALSE;
+		goto finish;
+	}
+
+	if (dec->metadata_only)
+	{
+		GST_DEBUG_OBJECT(dec, "metadata-only mode is enabled - cannot seek");
+		goto finish;
 	}
 
 	GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
@@ -1806,7 +2227,7 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 	{
 		GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 		GST_DEBUG_OBJECT(dec, "no valid output audioinfo present - cannot seek");
-		return FALSE;
+		goto finish;
 	}
 	GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 
@@ -1830,13 +2251,13 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 	if (format != GST_FORMAT_TIME)
 	{
 		GST_DEBUG_OBJECT(dec, "seeking is only supported in TIME format");
-		return FALSE;
+		goto finish;
 	}
 
 	if (rate < 0)
 	{
 		GST_DEBUG_OBJECT(dec, "only positive seek rates are supported");
-		return FALSE;
+		goto finish;
 	}
 
 	flush = ((flags & GST_SEEK_FLAG_FLUSH) == GST_SEEK_FLAG_FLUSH);
@@ -1848,7 +2269,7 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 
 		GST_DEBUG_OBJECT(dec, "sending flush start event with sequence number %" G_GUINT32_FORMAT, seqnum);
 
-		gst_pad_push_event(dec->srcpad, gst_event_ref(fevent));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_ref(fevent));
 	        /* unlock upstream pull_range */
 		if (klass->loads_from_sinkpad)
 		        gst_pad_push_event(dec->sinkpad, fevent);
@@ -1862,6 +2283,16 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 
 	segment = dec->cur_segment;
 
+	/* if a previous seek let the subclass apply its rate, the current
+	 * segment is in the output timeline; go back to media time, since
+	 * the seek positions are in media time */
+	if (segment.applied_rate != 1.0)
+	{
+		gst_nonstream_audio_decoder_scale_segment(&segment, segment.applied_rate);
+		segment.rate *= segment.applied_rate;
+		segment.applied_rate = 1.0;
+	}
+
 	if (!gst_segment_do_seek(
 		&segment,
 		rate,
@@ -1874,9 +2305,10 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 		NULL
 	))
 	{
-    		GST_DEBUG_OBJECT(dec, "could not seek in segment");
-		GST_PAD_STREAM_UNLOCK(dec->srcpad);
-		return FALSE;
+		/* a flush start event may already have been sent, so
+		 * go on with the flush stop even though the seek failed */
+		GST_DEBUG_OBJECT(dec, "could not seek in segment");
+		goto stop_flush;
 	}
 
 	GST_DEBUG_OBJECT(
@@ -1906,15 +2338,68 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 	GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
 
 	new_position = segment.position;
+
+	/* KEY_UNIT seeks do not have to be sample accurate; let the
+	 * subclass land on a position it can reach cheaply */
+	if (flags & GST_SEEK_FLAG_KEY_UNIT)
+		new_position = gst_nonstream_audio_decoder_snap_seek_position(dec, new_position, segment.stop, flags);
+
 	res = klass->seek(dec, &new_position);
+	if (!res)
+	{
+		/* keep the current segment and the current rate, since
+		 * playback continues (if it does) where it was before */
+		GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+		goto stop_flush;
+	}
+
 	segment.position = new_position;
 
+	/* let the subclass render faster or slower by itself if it can, which
+	 * is much cheaper than rendering everything and letting downstream
+	 * drop or stretch the data; this is done for every seek, so a seek
+	 * with rate 1.0 restores normal playback. This is done only after
+	 * the seek succeeded, otherwise the subclass would continue with the
+	 * new rate while the current segment still has the old one. */
+	applied_rate = 1.0;
+	if (klass->set_playback_rate != NULL)
+	{
+		applied_rate = klass->set_playback_rate(dec, rate);
+		if (applied_rate <= 0.0)
+			applied_rate = 1.0;
+		GST_DEBUG_OBJECT(dec, "requested rate %f, subclass applied rate %f", rate, applied_rate);
+	}
+
+	/* report the actual position in the new segment; otherwise,
+	 * downstream would clip away the samples between the position
+	 * that was reached and the position that was requested */
+	if (flags & GST_SEEK_FLAG_KEY_UNIT)
+	{
+		segment.start = new_position;
+		segment.time = new_position;
+	}
+
+	/* the data the subclass produces is already sped up or slowed down,
+	 * so the output timeline is compressed or stretched accordingly, and
+	 * downstream only needs to apply the remainder of the rate */
+	if (applied_rate != 1.0)
+	{
+		segment.rate = rate / applied_rate;
+		segment.applied_rate = applied_rate;
+		gst_nonstream_audio_decoder_scale_segment(&segment, 1.0 / applied_rate);
+	}
+
 	dec->cur_segment = segment;
 	dec->cur_pos_in_samples = gst_util_uint64_scale_int(dec->cur_segment.position, dec->output_audio_info.rate, GST_SECOND);
-	dec->num_decoded_samples = 0;
+	/* only a flushing seek resets the running time; with non-flushing
+	 * seeks, gst_segment_do_seek() accumulated the running time that
+	 * elapsed so far into the segment base */
+	if (flush)
+		dec->num_decoded_samples = 0;
 
 	GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 
+stop_flush:
 	if (flush)
 	{
 		GstEvent *fevent = gst_event_new_flush_stop(TRUE);
@@ -1922,7 +2407,7 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 
 		GST_DEBUG_OBJECT(dec, "sending flush stop event with sequence number %" G_GUINT32_FORMAT, seqnum);
 
-		gst_pad_push_event(dec->srcpad, gst_event_ref(fevent));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_ref(fevent));
 		if (klass->loads_from_sinkpad)
 		        gst_pad_push_event(dec->sinkpad, fevent);
 		else
@@ -1944,7 +2429,7 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 			);
 		}
 
-		gst_pad_push_event(dec->srcpad, gst_event_new_segment(&segment));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_segment(&segment));
 
 		GST_INFO_OBJECT(dec, "seek succeeded");
 
@@ -1953,10 +2438,16 @@ static gboolean gst_nonstream_audio_decoder_do_seek(GstNonstreamAudioDecoder *de
 	else
 	{
 		GST_WARNING_OBJECT(dec, "seek failed");
+
+		/* the task was paused above for non-flushing seeks;
+		 * resume playback at the old position */
+		if (!flush)
+			gst_nonstream_audio_decoder_start_task(dec);
 	}
 
 	GST_PAD_STREAM_UNLOCK(dec->srcpad);
 
+finish:
 	gst_event_unref(event);
 
 	return res;
@@ -2000,11 +2491,148 @@ static GstTagList * gst_nonstream_audio_decoder_add_main_tags(GstNonstreamAudioD
 }
 
 
+static gboolean gst_nonstream_audio_decoder_push_src_event(GstNonstreamAudioDecoder *dec, GstEvent *event)
+{
+	/* Pushes the event to the srcpad and to all voice srcpads. The
+	 * return value is the result of the push to the srcpad, since the
+	 * voice srcpads are optional extras. */
+
+	gboolean res;
+	guint i, num_voice_srcpads;
+	GstPad **voice_srcpads;
+
+	num_voice_srcpads = gst_nonstream_audio_decoder_get_voice_srcpads(dec, &voice_srcpads, NULL);
+
+	res = gst_pad_push_event(dec->srcpad, gst_event_ref(event));
+
+	for (i = 0; i < num_voice_srcpads; ++i)
+	{
+		GstEvent *voice_event;
+
+		/* each voice is a stream of its own, and needs its own stream ID */
+		if (GST_EVENT_TYPE(event) == GST_EVENT_STREAM_START)
+			voice_event = gst_nonstream_audio_decoder_new_voice_stream_start(dec, voice_srcpads[i], event);
+		else
+			voice_event = gst_event_ref(event);
+
+		gst_pad_push_event(voice_srcpads[i], voice_event);
+		gst_object_unref(GST_OBJECT(voice_srcpads[i]));
+	}
+
+	g_free(voice_srcpads);
+	gst_event_unref(event);
+
+	return res;
+}
+
+
+static GstEvent* gst_nonstream_audio_decoder_new_voice_stream_start(GstNonstreamAudioDecoder *dec, GstPad *voice_srcpad, GstEvent *stream_start_event)
+{
+	gchar *stream_id;
+	GstEvent *event;
+	guint group_id;
+
+	stream_id = gst_pad_create_stream_id(voice_srcpad, GST_ELEMENT_CAST(dec), GST_PAD_NAME(voice_srcpad));
+	event = gst_event_new_stream_start(stream_id);
+	g_free(stream_id);
+
+	/* all voices belong to the same group as the main output */
+	if (gst_event_parse_group_id(stream_start_event, &group_id))
+		gst_event_set_group_id(event, group_id);
+
+	return event;
+}
+
+
+static gboolean gst_nonstream_audio_decoder_copy_sticky_event(GstPad *pad, GstEvent **event, gpointer user_data)
+{
+	GstPad *voice_srcpad = GST_PAD(user_data);
+	GstNonstreamAudioDecoder *dec = GST_NONSTREAM_AUDIO_DECODER(gst_pad_get_parent_element(pad));
+
+	if (GST_EVENT_TYPE(*event) == GST_EVENT_STREAM_START)
+	{
+		GstEvent *voice_event = gst_nonstream_audio_decoder_new_voice_stream_start(dec, voice_srcpad, *event);
+		gst_pad_store_sticky_event(voice_srcpad, voice_event);
+		gst_event_unref(voice_event);
+	}
+	else
+		gst_pad_store_sticky_event(voice_srcpad, *event);
+
+	gst_object_unref(GST_OBJECT(dec));
+
+	return TRUE;
+}
+
+
+static guint gst_nonstream_audio_decoder_get_voice_srcpads(GstNonstreamAudioDecoder *dec, GstPad ***voice_srcpads, guint **voices)
+{
+	/* Returns refs to the currently requested voice srcpads, and
+	 * optionally their voice indices. The caller has to unref the
+	 * pads, and free both arrays with g_free(). */
+
+	GList *walk;
+	guint i, num_voice_srcpads;
+
+	GST_OBJECT_LOCK(dec);
+
+	num_voice_srcpads = g_list_length(dec->voice_srcpads);
+	*voice_srcpads = (num_voice_srcpads > 0) ? g_new(GstPad*, num_voice_srcpads) : NULL;
+	if (voices != NULL)
+		*voices = (num_voice_srcpads > 0) ? g_new(guint, num_voice_srcpads) : NULL;
+
+	for (walk = dec->voice_srcpads, i = 0; walk != NULL; walk = walk->next, ++i)
+	{
+		GstPad *voice_srcpad = GST_PAD(walk->data);
+		(*voice_srcpads)[i] = gst_object_ref(voice_srcpad);
+		if (voices != NULL)
+			(*voices)[i] = GPOINTER_TO_UINT(gst_pad_get_element_private(voice_srcpad));
+	}
+
+	GST_OBJECT_UNLOCK(dec);
+
+	return num_voice_srcpads;
+}
+
+
+static GstBuffer* gst_nonstream_audio_decoder_fit_output_buffer(GstNonstreamAudioDecoder *dec, GstBuffer *buffer, guint num_samples, guint num_clipped_samples)
+{
+	/* must be called with lock */
+
+	gint bpf = GST_AUDIO_INFO_BPF(&(dec->output_audio_info));
+
+#if GST_CHECK_VERSION(1, 16, 0)
+	/* Non-interleaved buffers must carry a GstAudioMeta that describes
+	 * where the planes are. If decode() did not add one, the planes
+	 * are stored back to back, each with num_samples samples. */
+	if ((GST_AUDIO_INFO_LAYOUT(&(dec->output_audio_info)) == GST_AUDIO_LAYOUT_NON_INTERLEAVED) && (gst_buffer_get_audio_meta(buffer) == NULL))
+	{
+		buffer = gst_buffer_make_writable(buffer);
+		gst_buffer_add_audio_meta(buffer, &(dec->output_audio_info), num_samples, NULL);
+	}
+
+	/* gst_audio_buffer_truncate() also adjusts the GstAudioMeta, so
+	 * non-interleaved buffers get clipped correctly */
+	if (num_clipped_samples != num_samples)
+		buffer = gst_audio_buffer_truncate(buffer, bpf, 0, num_clipped_samples);
+#else
+	if (num_clipped_samples != num_samples)
+		gst_buffer_resize(buffer, 0, num_clipped_samples * bpf);
+#endif
+
+	return buffer;
+}
+
+
 static void gst_nonstream_audio_decoder_output_task(GstNonstreamAudioDecoder *dec)
 {
 	GstFlowReturn flow;
 	GstBuffer *outbuf;
-	guint num_samples;
+	guint num_samples, num_rendered_samples;
+	guint64 stop_in_samples;
+	guint i, num_voice_srcpads;
+	GstPad **voice_srcpads = NULL;
+	guint *voices = NULL;
+	GstBuffer **voice_outbufs = NULL;
 
 	GstNonstreamAudioDecoderClass *klass;
 	klass = GST_NONSTREAM_AUDIO_DECODER_CLASS(G_OBJECT_GET_CLASS(dec));
@@ -2012,13 +2640,44 @@ static void gst_nonstream_audio_decoder_output_task(GstNonstreamAudioDecoder *de
 
 	GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
 
+	/* in metadata-only mode, tags, TOC, and segment have already been
+	 * sent by finish_load(); there is nothing to decode */
+	if (dec->metadata_only)
+	{
+		GST_INFO_OBJECT(dec, "metadata-only mode is enabled -> sending EOS event without decoding");
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_eos());
+		goto pause_unlock;
+	}
+
+	/* the subclass may have found out more about the subsongs
+	 * after loading (see gst_nonstream_audio_decoder_subsong_info_changed()) */
+	if (G_UNLIKELY(g_atomic_int_compare_and_exchange(&(dec->subsong_info_changed), 1, 0)))
+		gst_nonstream_audio_decoder_refresh_subsong_info(dec, klass);
+
+	/* if the segment has a stop position, and it has been reached,
+	 * do not decode anything anymore; the stop position is in the
+	 * same timebase as the buffer timestamps (see do_seek()) */
+	if (GST_CLOCK_TIME_IS_VALID(dec->cur_segment.stop))
+		stop_in_samples = gst_util_uint64_scale_int(dec->cur_segment.stop, dec->output_audio_info.rate, GST_SECOND);
+	else
+		stop_in_samples = G_MAXUINT64;
+
+	if (dec->cur_pos_in_samples >= stop_in_samples)
+	{
+		GST_INFO_OBJECT(dec, "segment stop position %" GST_TIME_FORMAT " reached", GST_TIME_ARGS(dec->cur_segment.stop));
+		GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+		gst_nonstream_audio_decoder_output_segment_end(dec);
+		goto pause;
+	}
+
 	/* perform the actual decoding */
 	if (!(klass->decode(dec, &outbuf, &num_samples)))
 	{
-		/* EOS case */
-		GST_INFO_OBJECT(dec, "decode() reports end -> sending EOS event");
-		gst_pad_push_event(dec->srcpad, gst_event_new_eos());
-		goto pause_unlock;
+		/* EOS case (or SEGMENT_DONE case for segment seeks) */
+		GST_INFO_OBJECT(dec, "decode() reports end");
+		GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+		gst_nonstream_audio_decoder_output_segment_end(dec);
+		goto pause;
 	}
 
 	if (outbuf == NULL)
@@ -2027,6 +2686,19 @@ static void gst_nonstream_audio_decoder_output_task(GstNonstreamAudioDecoder *de
 		goto pause_unlock;
 	}
 
+	num_rendered_samples = num_samples;
+
+	/* clip the last buffer of the segment sample-accurately, so the
+	 * output ends exactly at the stop position */
+	if (G_UNLIKELY((dec->cur_pos_in_samples + num_samples) > stop_in_samples))
+	{
+		guint num_clipped_samples = (guint)(stop_in_samples - dec->cur_pos_in_samples);
+		GST_LOG_OBJECT(dec, "clipping output buffer from %u to %u samples to honor segment stop position", num_samples, num_clipped_samples);
+		num_samples = num_clipped_samples;
+	}
+
+	outbuf = gst_nonstream_audio_decoder_fit_output_buffer(dec, outbuf, num_rendered_samples, num_samples);
+
 	/* set the buffer's metadata */
 	GST_BUFFER_DURATION(outbuf)   = gst_util_uint64_scale_int(num_samples, GST_SECOND, dec->output_audio_info.rate);
 	GST_BUFFER_OFFSET(outbuf)     = dec->cur_pos_in_samples;
@@ -2053,6 +2725,10 @@ static void gst_nonstream_audio_decoder_output_task(GstNonstreamAudioDecoder *de
 	dec->cur_pos_in_samples += num_samples;
 	dec->num_decoded_samples += num_samples;
 
+	/* keep the segment position up to date; gst_segment_do_seek()
+	 * needs it to compute the base of non-flushing seeks */
+	dec->cur_segment.position = GST_BUFFER_PTS(outbuf) + GST_BUFFER_DURATION(outbuf);
+
 	/* the decode() call might have set a new output format -> renegotiate
 	 * before sending the new buffer downstream */
 	if (G_UNLIKELY(
@@ -2068,12 +2744,61 @@ static void gst_nonstream_audio_decoder_output_task(GstNonstreamAudioDecoder *de
 		}
 	}
 
+	/* render the voices for the requested voice srcpads; the voice
+	 * buffers cover exactly the same span of samples as outbuf */
+	num_voice_srcpads = (klass->decode_voices != NULL) ? gst_nonstream_audio_decoder_get_voice_srcpads(dec, &voice_srcpads, &voices) : 0;
+	if (num_voice_srcpads > 0)
+	{
+		voice_outbufs = g_new0(GstBuffer*, num_voice_srcpads);
+
+		if (klass->decode_voices(dec, voices, voice_outbufs, num_voice_srcpads, num_rendered_samples))
+		{
+			for (i = 0; i < num_voice_srcpads; ++i)
+			{
+				if (voice_outbufs[i] == NULL)
+					continue;
+
+				voice_outbufs[i] = gst_nonstream_audio_decoder_fit_output_buffer(dec, voice_outbufs[i], num_rendered_samples, num_samples);
+
+				gst_buffer_copy_into(voice_outbufs[i], outbuf, GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+			}
+		}
+		else
+		{
+			GST_WARNING_OBJECT(dec, "could not render voices - not pushing voice buffers");
+			for (i = 0; i < num_voice_srcpads; ++i)
+			{
+				if (voice_outbufs[i] != NULL)
+				{
+					gst_buffer_unref(voice_outbufs[i]);
+					voice_outbufs[i] = NULL;
+				}
+			}
+		}
+	}
+
 	GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
 
 	/* push new samples downstream
 	 * no need to unref buffer - gst_pad_push() does it in
 	 * all cases (success and failure) */
 	flow = gst_pad_push(dec->srcpad, outbuf);
+
+	/* voice srcpads are optional extras; their flow returns do not
+	 * affect the task (unlinked voice pads are fine, for example) */
+	for (i = 0; i < num_voice_srcpads; ++i)
+	{
+		if (voice_outbufs[i] != NULL)
+		{
+			GstFlowReturn voice_flow = gst_pad_push(voice_srcpads[i], voice_outbufs[i]);
+			if ((voice_flow != GST_FLOW_OK) && (voice_flow != GST_FLOW_NOT_LINKED))
+				GST_LOG_OBJECT(dec, "pushing buffer over pad %s:%s failed: %s", GST_DEBUG_PAD_NAME(voice_srcpads[i]), gst_flow_get_name(voice_flow));
+		}
+		gst_object_unref(GST_OBJECT(voice_srcpads[i]));
+	}
+	g_free(voice_srcpads);
+	g_free(voices);
+	g_free(voice_outbufs);
 	switch (flow)
 	{
 		case GST_FLOW_OK:
@@ -2109,6 +2834,42 @@ pause_unlock:
 }
 
 
+static void gst_nonstream_audio_decoder_output_segment_end(GstNonstreamAudioDecoder *dec)
+{
+	/* must be called without lock, since a message is posted here */
+
+	GstFormat format;
+	gint64 position;
+	guint64 end_position;
+	gboolean is_segment_seek;
+
+	GST_NONSTREAM_AUDIO_DECODER_LOCK_MUTEX(dec);
+	is_segment_seek = (dec->cur_segment.flags & GST_SEGMENT_FLAG_SEGMENT) != 0;
+	format = dec->cur_segment.format;
+	/* The stop and position values are in the output timeline, which
+	 * differs from the stream time if the subclass applies a rate by
+	 * itself (see do_seek()). Post the stream time, since that is what
+	 * the application used for the stop position of its seek. */
+	end_position = GST_CLOCK_TIME_IS_VALID(dec->cur_segment.stop) ? dec->cur_segment.stop : dec->cur_segment.position;
+	position = (gint64)gst_segment_to_stream_time(&(dec->cur_segment), format, end_position);
+	GST_NONSTREAM_AUDIO_DECODER_UNLOCK_MUTEX(dec);
+
+	if (is_segment_seek)
+	{
+		/* segment seeks do not end with EOS; instead, the application
+		 * gets a SEGMENT_DONE message, and can issue the next segment seek */
+		GST_INFO_OBJECT(dec, "end of segment seek -> posting SEGMENT_DONE message and sending SEGMENT_DONE event");
+		gst_element_post_message(GST_ELEMENT(dec), gst_message_new_segment_done(GST_OBJECT(dec), format, position));
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_segment_done(format, position));
+	}
+	else
+	{
+		GST_INFO_OBJECT(dec, "end of segment -> sending EOS event");
+		gst_nonstream_audio_decoder_push_src_event(dec, gst_event_new_eos());
+	}
+}
+
+
 static char const * get_seek_type_name(GstSeekType seek_type)
 {
 	switch (seek_type)
@@ -2408,6 +3169,87 @@ void gst_nonstream_audio_decoder_get_downstream_info(GstNonstreamAudioDecoder *d
 }
 
 
+/**
+ * gst_nonstream_audio_decoder_get_downstream_layout:
+ * @dec: a #GstNonstreamAudioDecoder
+ * @layout: #GstAudioLayout value to fill with a sample layout
+ *
+ * Gets the sample layout from the allowed srcpad caps.
+ *
+ * This works just like gst_nonstream_audio_decoder_get_downstream_info(),
+ * except that it looks at the "layout" field. The value @layout points to
+ * is the preferred layout; it is kept if downstream accepts it, and also
+ * if no downstream caps can be retrieved. Subclasses that can render
+ * directly into separate channel planes should pass
+ * GST_AUDIO_LAYOUT_INTERLEAVED as the preferred layout, and switch to
+ * non-interleaved output only if downstream requires it. This avoids an
+ * extra interleaving pass in downstream elements that cannot handle planar
+ * audio.
+ *
+ * Decoder lock is not held by this function, so it can be called from within
+ * any of the class vfuncs.
+ */
+void gst_nonstream_audio_decoder_get_downstream_layout(GstNonstreamAudioDecoder *dec, GstAudioLayout *layout)
+{
+	GstCaps *allowed_srccaps;
+	guint structure_nr, num_structures;
+	gchar const *preferred_layout_str;
+	gboolean ds_layout_found = FALSE;
+
+	g_return_if_fail(GST_IS_NONSTREAM_AUDIO_DECODER(dec));
+	g_return_if_fail(layout != NULL);
+
+	allowed_srccaps = gst_pad_get_allowed_caps(dec->srcpad);
+	if (allowed_srccaps == NULL)
+	{
+		GST_INFO_OBJECT(dec, "no downstream caps available - not modifying layout");
+		return;
+	}
+
+	preferred_layout_str = (*layout == GST_AUDIO_LAYOUT_NON_INTERLEAVED) ? "non-interleaved" : "interleaved";
+
+	num_structures = gst_caps_get_size(allowed_srccaps);
+	for (structure_nr = 0; structure_nr < num_structures; ++structure_nr)
+	{
+		GstStructure *fixated_str;
+		gchar const *layout_str;
+
+		fixated_str = gst_structure_copy(gst_caps_get_structure(allowed_srccaps, structure_nr));
+
+		if (!gst_structure_has_field(fixated_str, "layout"))
+			layout_str = preferred_layout_str;
+		else if ((gst_structure_get_field_type(fixated_str, "layout") == G_TYPE_STRING) || gst_structure_fixate_field_string(fixated_str, "layout", preferred_layout_str))
+			layout_str = gst_structure_get_string(fixated_str, "layout");
+		else
+			layout_str = NULL;
+
+		if (g_strcmp0(layout_str, "interleaved") == 0)
+		{
+			*layout = GST_AUDIO_LAYOUT_INTERLEAVED;
+			ds_layout_found = TRUE;
+		}
+		else if (g_strcmp0(layout_str, "non-interleaved") == 0)
+		{
+			*layout = GST_AUDIO_LAYOUT_NON_INTERLEAVED;
+			ds_layout_found = TRUE;
+		}
+
+		gst_structure_free(fixated_str);
+
+		if (ds_layout_found)
+		{
+			GST_DEBUG_OBJECT(dec, "found fixated layout: %s", (*layout == GST_AUDIO_LAYOUT_NON_INTERLEAVED) ? "non-interleaved" : "interleaved");
+			break;
+		}
+	}
+
+	gst_caps_unref(allowed_srccaps);
+
+	if (!ds_layout_found)
+		GST_INFO_OBJECT(dec, "downstream did not specify layout - using default (%s)", preferred_layout_str);
+}
+
+
 /**
  * gst_nonstream_audio_decoder_allocate_output_buffer:
  * @dec: Decoder instance
@@ -2439,3 +3281,51 @@ GstBuffer* gst_nonstream_audio_decoder_allocate_output_buffer(GstNonstreamAudioD
 
 	return gst_buffer_new_allocate(dec->allocator, size, &(dec->allocation_params));
 }
+
+
+/**
+ * gst_nonstream_audio_decoder_is_loading_cancelled:
+ * @dec: Decoder instance
+ *
+ * Checks if the decoder is shutting down while media is being loaded.
+ *
+ * Loading can take a long time with some formats, for example when all
+ * subsongs have to be scanned for their durations. The PAUSED->READY
+ * state change cannot complete until @load_from_buffer returns, so
+ * derived classes should periodically call this function during such
+ * lengthy operations, and abort loading (returning FALSE) if it returns
+ * TRUE. No error is posted in that case.
+ *
+ * Decoder lock is not required by this function, so it can be called from
+ * within any of the class vfuncs, and from any thread.
+ *
+ * Returns: TRUE if loading should be aborted, FALSE otherwise
+ */
+gboolean gst_nonstream_audio_decoder_is_loading_cancelled(GstNonstreamAudioDecoder *dec)
+{
+	g_return_val_if_fail(GST_IS_NONSTREAM_AUDIO_DECODER(dec), FALSE);
+	return g_atomic_int_get(&(dec->loading_cancelled)) != 0;
+}
+
+
+/**
+ * gst_nonstream_audio_decoder_subsong_info_changed:
+ * @dec: Decoder instance
+ *
+ * Informs the base class that the subsong durations or the TOC sub-entries
+ * changed after loading. This is useful for subclasses which find out about
+ * these in the background, so that playback can begin before that work is
+ * finished.
+ *
+ * The base class then queries @get_subsong_duration and @fill_toc_entry
+ * again from the streaming thread, before the next @decode call, and sends
+ * the updated TOC and a duration-changed message.
+ *
+ * Decoder lock is not required by this function, so it can be called from
+ * within any of the class vfuncs, and from any thread.
+ */
+void gst_nonstream_audio_decoder_subsong_info_changed(GstNonstreamAudioDecoder *dec)
+{
+	g_return_if_fail(GST_IS_NONSTREAM_AUDIO_DECODER(dec));
+	g_atomic_int_set(&(dec->subsong_info_changed), 1);
+}
@@ -153,8 +153,10 @@ struct _GstNonstreamAudioDecoder
 	gboolean output_format_changed;
 	GstAudioInfo output_audio_info;
 	/* The difference between these two values is: cur_pos_in_samples is
-	 * used for the GstBuffer offsets, while num_decoded_samples is used
-	 * for the segment base time values.
+	 * used for the GstBuffer offsets, while num_decoded_samples counts all
+	 * samples that were output since the last flush. (Segment base time
+	 * values are derived from the running time of the current segment,
+	 * since segments can have different rates.)
 	 * cur_pos_in_samples is reset after seeking, looping (when output mode
 	 * is LOOPING) and switching subsongs, while num_decoded is only reset
 	 * to 0 after a flushing seek (because flushing seeks alter the
@@ -172,6 +174,23 @@ struct _GstNonstreamAudioDecoder
 
 	/* thread safety */
 	GMutex mutex;
+
+	/* The fields below were added after the first release. They are
+	 * kept at the end, so the layout of the fields above stays the same
+	 * as the one of the GstNonstreamAudioDecoder in gst-plugins-bad. If
+	 * that base class is used (see HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	 * below), it never touches them, so they stay zero (metadata_only is
+	 * then always FALSE, for example). */
+
+	/* requested voice_%u source pads (protected by the object lock) */
+	GList *voice_srcpads;
+
+	/* loading information */
+	gboolean metadata_only;
+	volatile gint loading_cancelled;
+
+	/* subsong states */
+	volatile gint subsong_info_changed;
 };
 
 
@@ -191,6 +210,23 @@ struct _GstNonstreamAudioDecoder
  *                              The position that this function returns must be relative to
  *                              the current subsong. Thus, the minimum is 0, and the maximum
  *                              is the subsong length.
+ * @find_seek_points:           Optional.
+ *                              Called when a seek event with the KEY_UNIT flag is received. Such seeks do not need
+ *                              to be sample accurate, so the decoder may land on a nearby position it can seek to
+ *                              cheaply instead (a checkpoint, the start of a pattern row etc.). position is relative
+ *                              to the current subsong. The function must set *point_before to the closest such
+ *                              position that is <= position, and *point_after to the closest one that is > position
+ *                              (or to GST_CLOCK_TIME_NONE if there is none). The base class picks one of the two
+ *                              based on the SNAP_BEFORE / SNAP_AFTER seek flags and passes it to @seek. If this
+ *                              function returns FALSE, or if it is set to NULL, the requested position is used as-is.
+ * @set_playback_rate:          Optional.
+ *                              Called when a seek event with a positive rate is received, before @seek. If the
+ *                              decoder can render the media faster or slower by itself (for example by changing
+ *                              the tempo of a module), it should do so, and return the rate it actually applied
+ *                              (which may be less than the requested one, if the decoder has an upper limit).
+ *                              The base class then produces a segment with this rate as its applied_rate, and
+ *                              leaves only the remainder of the requested rate to downstream. Return 1.0 to not
+ *                              apply any rate. Positions (in @seek, @tell etc.) stay in media time.
  * @load_from_buffer:           Required if loads_from_sinkpad is set to TRUE (the default value).
  *                              Loads the media from the given buffer. The entire media is supplied at once,
  *                              so after this call, loading should be finished. This function
@@ -240,6 +276,13 @@ struct _GstNonstreamAudioDecoder
  * @get_subsong_tags:           Optional.
  *                              Returns tags for a subsong, or NULL if there are no tags.
  *                              Returned tags will be unref'd.
+ * @fill_toc_entry:             Optional.
+ *                              Adds sub-entries (for example, the patterns of a module) to the TOC entry of a subsong.
+ *                              Each sub-entry must have a UID that is unique within the TOC, and its start time
+ *                              must be relative to the beginning of the subsong. When a TOC select event for a
+ *                              sub-entry is received, the base class switches to its subsong (if necessary) and
+ *                              then seeks to the sub-entry's start time with an accurate seek. If this is set, a
+ *                              TOC is produced even if there is only one subsong.
  * @set_subsong_mode:           Optional.
  *                              Sets the current subsong mode. Since this might influence the current playback position,
  *                              this function must set the initial_position integer argument to a defined value.
@@ -276,6 +319,22 @@ struct _GstNonstreamAudioDecoder
  *                              *buffer . The number of decoded samples must be passed on to *num_samples.
  *                              If decoding finishes or the decoding is no longer possible (for example, due to an
  *                              unrecoverable error), this function returns FALSE, otherwise TRUE.
+ *                              If the output layout is non-interleaved, the buffer should carry a GstAudioMeta
+ *                              describing the planes. If it does not, the planes are assumed to be stored back to
+ *                              back, each containing exactly *num_samples samples.
+ * @get_num_voices:             Optional.
+ *                              Returns the number of voices (channels, for example) in the loaded media that can
+ *                              be rendered separately by @decode_voices.
+ * @decode_voices:              Optional.
+ *                              Renders individual voices for the voice_%u request srcpads. This is called right
+ *                              after a successful @decode call, and must render the same num_samples samples that
+ *                              @decode just produced, but for each voice in the voices array separately. The
+ *                              buffers must be allocated with gst_nonstream_audio_decoder_allocate_output_buffer()
+ *                              and stored in the buffers array, at the same index as the voice. Their sample
+ *                              format is the same as the one of the buffers produced by @decode. If a voice index
+ *                              exceeds the number of voices in the media, the voice must be rendered as silence.
+ *                              Returns FALSE if the voices could not be rendered.
+ *                              If this is set, the subclass must add a request pad template called "voice_%u".
  * @decide_allocation:          Optional.
  *                              Sets up the allocation parameters for allocating output
  *                              buffers. The passed in query contains the result of the
@@ -308,6 +367,22 @@ struct _GstNonstreamAudioDecoder
  * For some formats (such as TFMX), it needs to do the file loading by itself.
  * Since most decoders can read input data from a memory block, the default value of
  * loads_from_sinkpad is TRUE.
+ *
+ * Subclasses which can render voices (channels, instruments etc.) separately can implement
+ * @get_num_voices and @decode_voices, and add a "voice_%u" request srcpad template.
+ * Applications then request one pad per voice they are interested in (the num-voices
+ * property tells how many there are). The voice buffers are rendered alongside the
+ * regular output in the same output task iteration, get the same timestamps, and all
+ * events are sent over the voice pads as well. Since one streaming thread drives all
+ * srcpads, downstream must decouple them with queues.
+ *
+ * If the metadata-only property is set, the media is loaded, its tags and TOC are sent
+ * downstream, and then EOS is sent without decoding anything. Subclasses should check the
+ * metadata_only field inside @load_from_buffer and @load_from_custom and skip any setup
+ * that is only needed for rendering (emulator, sigrenderer, and resampler initialization,
+ * for example). @get_main_tags, @get_num_subsongs, @get_subsong_duration, and
+ * @get_subsong_tags must still work in this mode. @decode and @seek are never called
+ * in metadata-only mode, and subsong switches are refused.
  */
 struct _GstNonstreamAudioDecoderClass
 {
@@ -347,8 +422,23 @@ struct _GstNonstreamAudioDecoderClass
 	gboolean (*decide_allocation)(GstNonstreamAudioDecoder *dec, GstQuery *query);
 	gboolean (*propose_allocation)(GstNonstreamAudioDecoder *dec, GstQuery * query);
 
+	/* The vfuncs below were added after the first release. They are
+	 * taken out of the padding, so the layout of the vfuncs above stays
+	 * the same as the one of the GstNonstreamAudioDecoderClass in
+	 * gst-plugins-bad. Subclasses must only use them (and the functions
+	 * which were added along with them) if HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS
+	 * is defined, since they are not available with --disable-base-class. */
+
+	gboolean     (*find_seek_points)(GstNonstreamAudioDecoder *dec, GstClockTime position, GstClockTime *point_before, GstClockTime *point_after);
+	gdouble      (*set_playback_rate)(GstNonstreamAudioDecoder *dec, gdouble rate);
+
+	void         (*fill_toc_entry)(GstNonstreamAudioDecoder *dec, guint subsong, GstTocEntry *entry);
+
+	guint    (*get_num_voices)(GstNonstreamAudioDecoder *dec);
+	gboolean (*decode_voices)(GstNonstreamAudioDecoder *dec, guint const *voices, GstBuffer **buffers, guint num_voices, guint num_samples);
+
 	/*< private >*/
-	gpointer _gst_reserved[GST_PADDING_LARGE];
+	gpointer _gst_reserved[GST_PADDING_LARGE - 5];
 };
 
 
@@ -364,6 +454,11 @@ void gst_nonstream_audio_decoder_get_downstream_info(GstNonstreamAudioDecoder *d
 
 GstBuffer* gst_nonstream_audio_decoder_allocate_output_buffer(GstNonstreamAudioDecoder *dec, gsize size);
 
+/* only available if HAVE_NONSTREAM_AUDIO_DECODER_EXTENSIONS is defined (see above) */
+void gst_nonstream_audio_decoder_get_downstream_layout(GstNonstreamAudioDecoder *dec, GstAudioLayout *layout);
+gboolean gst_nonstream_audio_decoder_is_loading_cancelled(GstNonstreamAudioDecoder *dec);
+void gst_nonstream_audio_decoder_subsong_info_changed(GstNonstreamAudioDecoder *dec);
+
 
 G_END_DECLS
 